@@ -0,0 +1,65 @@
+#include <aio.h>
+#include <stdint.h>
+
+#include "core_x4.h"
+#include "core_x8.h"
+#include "crypt_util.h"
+#include "dispatch.h"
+
+/*  Generates the key stream for the first nlanes lanes with the multi-block core and
+*   xor's every block into its message. Unused lanes (only at the end of the batch)
+*   are computed as well but their output is ignored.
+*/
+static void salsa20_batch_flush(size_t nlanes, size_t width, const size_t lens[], const uint8_t* const ins[], uint8_t* const outs[],
+                                uint32_t key[8], const uint64_t lane_ivs[8], const uint64_t lane_counters[8], const size_t lane_msgs[8]) {
+    uint32_t output[128];
+
+    // A partly filled batch of the AVX2 core only needs the SSE2 core if four lanes are enough
+    if (width == 8 && nlanes > 4) {
+        salsa20_core_x8_lanes(output, key, lane_ivs, lane_counters);
+    } else {
+        salsa20_core_x4_lanes(output, key, lane_ivs, lane_counters);
+    }
+
+    for (size_t j = 0; j < nlanes; j++) {
+        size_t m = lane_msgs[j];
+        size_t pos = lane_counters[j] * 64;
+        size_t len = lens[m] - pos < 64 ? lens[m] - pos : 64;
+        salsa20_xor_block(ins[m] + pos, outs[m] + pos, (const uint8_t*) (output + 16 * j), len);
+    }
+}
+
+/*  En-/decrypts n independent messages under the same key: message i of lens[i] bytes
+*   at ins[i] is written to outs[i] with the key stream for the nonce ivs[i] (starting
+*   at offset 0). Instead of running the crypt once per message, which for short
+*   records means a single block per core call, the blocks of all messages are packed
+*   into the lanes of salsa20_core_x8_lanes (AVX2) or salsa20_core_x4_lanes. A lane
+*   only carries the nonce and counter of its block, so a batch of 64 byte records
+*   runs at nearly the speed of one long message. ins[i] == outs[i] is allowed.
+*/
+void salsa20_crypt_batch(size_t n, const size_t lens[], const uint8_t* const ins[], uint8_t* const outs[], uint32_t key[8], const uint64_t ivs[]) {
+    size_t width = (cpu_features() & CPU_FEATURE_AVX2) ? 8 : 4;
+    uint64_t lane_ivs[8] = { 0 };
+    uint64_t lane_counters[8] = { 0 };
+    size_t lane_msgs[8] = { 0 };
+    size_t nlanes = 0;
+
+    for (size_t m = 0; m < n; m++) {
+        uint64_t nblocks = ((uint64_t) lens[m] + 63) / 64;
+
+        for (uint64_t b = 0; b < nblocks; b++) {
+            lane_ivs[nlanes] = ivs[m];
+            lane_counters[nlanes] = b;
+            lane_msgs[nlanes] = m;
+
+            if (++nlanes == width) {
+                salsa20_batch_flush(nlanes, width, lens, ins, outs, key, lane_ivs, lane_counters, lane_msgs);
+                nlanes = 0;
+            }
+        }
+    }
+
+    if (nlanes) {
+        salsa20_batch_flush(nlanes, width, lens, ins, outs, key, lane_ivs, lane_counters, lane_msgs);
+    }
+}
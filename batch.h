@@ -0,0 +1,9 @@
+#ifndef SALSA20_BATCH_H
+#define SALSA20_BATCH_H
+
+#include <aio.h>
+#include <stdint.h>
+
+void salsa20_crypt_batch(size_t n, const size_t lens[], const uint8_t* const ins[], uint8_t* const outs[], uint32_t key[8], const uint64_t ivs[]);
+
+#endif  // SALSA20_BATCH_H
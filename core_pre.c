@@ -0,0 +1,39 @@
+#include <aio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "core_v2.h"
+#include "core_pre.h"
+
+/*  Within a message only the counter changes from block to block, and as long as
+*   its high word 9 stays the same only word 8. In the first column round word 8 only
+*   takes part in the quarter round of column 0, and there only from the second step
+*   on. The quarter rounds of the other columns and the first step of column 0 are
+*   computed once here. In the following row round, the quarter round of row 1 only
+*   sees words that are known by then, and so do the first steps of rows 2 and 3.
+*
+*   Of the 32 steps (add, rotate, xor) of the first double round the multi-block cores
+*   with precomputation (salsa20_core_x8_pre, salsa20_core_x16_pre) only compute 11
+*   plus 3 xor's per block, 21 of the 320 steps of Salsa20/20 (128 of Salsa20/8) are
+*   saved.
+*/
+void salsa20_precompute(struct salsa20_precomp* pre, const uint32_t input[16]) {
+    uint32_t* x = pre->x;
+
+    memcpy(pre->input, input, sizeof(pre->input));
+    memcpy(x, input, sizeof(pre->x));
+
+    // Column round without the counter dependent steps of column 0
+    SALSA_QROUND(x[ 5], x[ 9], x[13], x[ 1]);
+    SALSA_QROUND(x[10], x[14], x[ 2], x[ 6]);
+    SALSA_QROUND(x[15], x[ 3], x[ 7], x[11]);
+    x[4] ^= ROTATELEFT(x[0] + x[12], 7);
+    pre->x4_col = x[4];
+    pre->t8_col = ROTATELEFT(x[4] + x[0], 9);
+
+    // Row round: row 1 and the first steps of rows 2 and 3
+    pre->t12_row = ROTATELEFT(x[15] + x[14], 7);
+    SALSA_QROUND(x[ 5], x[ 6], x[ 7], x[ 4]);
+    x[11] ^= ROTATELEFT(x[10] + x[9], 7);
+    pre->t8_row = ROTATELEFT(x[11] + x[10], 9);
+}
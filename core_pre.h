@@ -0,0 +1,26 @@
+#ifndef SALSA20_CORE_PRE_H
+#define SALSA20_CORE_PRE_H
+
+#include <aio.h>
+#include <stdint.h>
+
+/*  Part of the first double round that is the same for every block of a key, iv and
+*   high counter word (see salsa20_precompute). x holds the words after the column
+*   round (columns 1 to 3 and word 4) and, for the words 4 to 7 and 11, after the row
+*   round. Words 0, 8 and 12 of x are the input. The t's are the terms that are xor'ed
+*   into the counter dependent words 8 and 12.
+*/
+struct salsa20_precomp {
+    uint32_t input[16];     // input matrix (word 8 is replaced per block)
+    uint32_t x[16];
+    uint32_t x4_col;        // word 4 after the column round
+    uint32_t t8_col;
+    uint32_t t8_row;
+    uint32_t t12_row;
+};
+
+typedef void (*core_pre_func)(uint32_t[], const struct salsa20_precomp*, uint32_t);
+
+void salsa20_precompute(struct salsa20_precomp* pre, const uint32_t input[16]);
+
+#endif  // SALSA20_CORE_PRE_H
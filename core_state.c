@@ -0,0 +1,150 @@
+#include <stdint.h>
+#include <emmintrin.h>
+
+#include "mtr_util.h"
+#include "core_state.h"
+
+/*  Sets up the state for the given key, iv and block counter. The matrix is
+*   written directly in the diagonal layout, so neither the core nor the crypt
+*   functions have to call rotate_simd for every block.
+*/
+void salsa20_state_init(struct salsa20_state* state, const uint32_t key[8], uint64_t iv, uint64_t counter) {
+    uint32_t diag[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+    uint32_t iv0 = iv & 0xffffffff;
+    uint32_t iv1 = iv >> 32;
+    uint32_t c0 = counter & 0xffffffff;
+    uint32_t c1 = counter >> 32;
+
+    state->row[0] = _mm_setr_epi32(diag[0], diag[1], diag[2], diag[3]);
+    state->row[1] = _mm_setr_epi32(key[3], c1, key[7], key[2]);
+    state->row[2] = _mm_setr_epi32(c0, key[6], key[1], iv1);
+    state->row[3] = _mm_setr_epi32(key[5], key[0], iv0, key[4]);
+}
+
+// Replaces the counter lanes of the state
+void salsa20_state_set_counter(struct salsa20_state* state, uint64_t counter) {
+    __m128i mask1 = _mm_setr_epi32(0, -1, 0, 0);
+    __m128i mask2 = _mm_setr_epi32(-1, 0, 0, 0);
+
+    state->row[1] = _mm_or_si128(_mm_andnot_si128(mask1, state->row[1]), _mm_setr_epi32(0, counter >> 32, 0, 0));
+    state->row[2] = _mm_or_si128(_mm_andnot_si128(mask2, state->row[2]), _mm_cvtsi32_si128(counter & 0xffffffff));
+}
+
+// Selects the lanes of a where the mask is set and the lanes of b everywhere else
+#define SELECT_SIMD(mask, a, b) (_mm_or_si128(_mm_and_si128((mask), (a)), _mm_andnot_si128((mask), (b))))
+
+/*  Runs the salsa20 double rounds on the pre-rotated state and returns the resulting
+*   block in natural order in z[0] to z[3] (words 0-3, 4-7, 8-11 and 12-15). The
+*   counter of the state is incremented afterwards. The double rounds are the same
+*   as in salsa20_core_v3, but the rows are taken from and (after the feed forward)
+*   converted back to the natural order in registers:
+*       e[0] = { z0, z9, z10, z3 }  e[1] = { z4, z13, z14, z7 }
+*       e[2] = { z8, z1, z2, z11 }  e[3] = { z12, z5, z6, z15 }
+*   are formed from two neighbouring diagonal rows each, and every row of the
+*   natural matrix is again formed from two of them. This needs only masked
+*   selects and no shuffles.
+*/
+static inline void salsa20_block_state(__m128i z[4], struct salsa20_state* state) {
+    __m128i r0 = state->row[0];
+    __m128i r1 = state->row[1];
+    __m128i r2 = state->row[2];
+    __m128i r3 = state->row[3];
+
+    __m128i tmp;
+
+    for (size_t i = 0; i < 10; i++) {
+        // rows
+        tmp = _mm_add_epi32(r3, r0);
+        r1 = _mm_xor_si128(r1, ROTL_SIMD(tmp, 7));
+
+        tmp = _mm_add_epi32(r0, r1);
+        r2 = _mm_xor_si128(r2, ROTL_SIMD(tmp, 9));
+
+        tmp = _mm_add_epi32(r1, r2);
+        r3 = _mm_xor_si128(r3, ROTL_SIMD(tmp, 13));
+
+        tmp = _mm_add_epi32(r2, r3);
+        r0 = _mm_xor_si128(r0, ROTL_SIMD(tmp, 18));
+
+        // pseudo-transpose
+        r1 = _mm_shuffle_epi32(r1, 0x93);
+        r2 = _mm_shuffle_epi32(r2, 0x4E);
+        r3 = _mm_shuffle_epi32(r3, 0x39);
+
+        // columns
+        tmp = _mm_add_epi32(r1, r0);
+        r3 = _mm_xor_si128(r3, ROTL_SIMD(tmp, 7));
+
+        tmp = _mm_add_epi32(r0, r3);
+        r2 = _mm_xor_si128(r2, ROTL_SIMD(tmp, 9));
+
+        tmp = _mm_add_epi32(r3, r2);
+        r1 = _mm_xor_si128(r1, ROTL_SIMD(tmp, 13));
+
+        tmp = _mm_add_epi32(r2, r1);
+        r0 = _mm_xor_si128(r0, ROTL_SIMD(tmp, 18));
+
+        // pseudo-re-transpose
+        r1 = _mm_shuffle_epi32(r1, 0x39);
+        r2 = _mm_shuffle_epi32(r2, 0x4E);
+        r3 = _mm_shuffle_epi32(r3, 0x93);
+    }
+
+    r0 = _mm_add_epi32(r0, state->row[0]);
+    r1 = _mm_add_epi32(r1, state->row[1]);
+    r2 = _mm_add_epi32(r2, state->row[2]);
+    r3 = _mm_add_epi32(r3, state->row[3]);
+
+    // Lanes 0 and 2 / lanes 0 and 3
+    __m128i mask02 = _mm_setr_epi32(-1, 0, -1, 0);
+    __m128i mask03 = _mm_setr_epi32(-1, 0, 0, -1);
+
+    __m128i e0 = SELECT_SIMD(mask02, r0, r1);
+    __m128i e1 = SELECT_SIMD(mask02, r1, r2);
+    __m128i e2 = SELECT_SIMD(mask02, r2, r3);
+    __m128i e3 = SELECT_SIMD(mask02, r3, r0);
+
+    z[0] = SELECT_SIMD(mask03, e0, e2);
+    z[1] = SELECT_SIMD(mask03, e1, e3);
+    z[2] = SELECT_SIMD(mask03, e2, e0);
+    z[3] = SELECT_SIMD(mask03, e3, e1);
+
+    // Increment the 64 bit counter in the registers: carry from lane 0 of row[2] into lane 1 of row[1]
+    __m128i low = _mm_add_epi32(state->row[2], _mm_cvtsi32_si128(1));
+    __m128i carry = _mm_and_si128(_mm_cmpeq_epi32(low, _mm_setzero_si128()), _mm_cvtsi32_si128(-1));
+    state->row[2] = low;
+    state->row[1] = _mm_sub_epi32(state->row[1], _mm_slli_si128(carry, 4));
+}
+
+/*  Generates one salsa20 block from the pre-rotated state and increments the block
+*   counter of the state afterwards. The key stream is written to output in little
+*   endian byte order, exactly like the output[16] of the other cores.
+*/
+void salsa20_core_state(uint8_t output[64], struct salsa20_state* state) {
+    __m128i z[4];
+    salsa20_block_state(z, state);
+
+    __m128i_u* out_ptr = (__m128i_u*) output;
+    _mm_storeu_si128(out_ptr, z[0]);
+    _mm_storeu_si128(out_ptr + 1, z[1]);
+    _mm_storeu_si128(out_ptr + 2, z[2]);
+    _mm_storeu_si128(out_ptr + 3, z[3]);
+}
+
+/*  Fused key stream generation and encryption of nblocks whole 64 byte blocks. The
+*   message is xor'ed directly with the registers of the feed forward, no key stream
+*   block is written to memory in between. in and out may be the same buffer.
+*/
+void salsa20_xor_blocks(struct salsa20_state* state, const uint8_t* in, uint8_t* out, size_t nblocks) {
+    for (size_t i = 0; i < nblocks; i++) {
+        __m128i z[4];
+        salsa20_block_state(z, state);
+
+        __m128i_u* in_ptr = (__m128i_u*) (in + 64 * i);
+        __m128i_u* out_ptr = (__m128i_u*) (out + 64 * i);
+        _mm_storeu_si128(out_ptr, _mm_xor_si128(_mm_loadu_si128(in_ptr), z[0]));
+        _mm_storeu_si128(out_ptr + 1, _mm_xor_si128(_mm_loadu_si128(in_ptr + 1), z[1]));
+        _mm_storeu_si128(out_ptr + 2, _mm_xor_si128(_mm_loadu_si128(in_ptr + 2), z[2]));
+        _mm_storeu_si128(out_ptr + 3, _mm_xor_si128(_mm_loadu_si128(in_ptr + 3), z[3]));
+    }
+}
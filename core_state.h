@@ -0,0 +1,27 @@
+#ifndef SALSA20_CORE_STATE_H
+#define SALSA20_CORE_STATE_H
+
+#include <aio.h>
+#include <stdint.h>
+#include <emmintrin.h>
+
+/*  Salsa20 input matrix in the diagonal layout of rotate_simd:
+*       row[0] = { m[ 0], m[ 5], m[10], m[15] }
+*       row[1] = { m[ 4], m[ 9], m[14], m[ 3] }
+*       row[2] = { m[ 8], m[13], m[ 2], m[ 7] }
+*       row[3] = { m[12], m[ 1], m[ 6], m[11] }
+*   The counter (m[8] and m[9]) is stored in lane 0 of row[2] and lane 1 of row[1].
+*/
+struct salsa20_state {
+    __m128i row[4];
+};
+
+void salsa20_state_init(struct salsa20_state* state, const uint32_t key[8], uint64_t iv, uint64_t counter);
+
+void salsa20_state_set_counter(struct salsa20_state* state, uint64_t counter);
+
+void salsa20_core_state(uint8_t output[64], struct salsa20_state* state);
+
+void salsa20_xor_blocks(struct salsa20_state* state, const uint8_t* in, uint8_t* out, size_t nblocks);
+
+#endif  // SALSA20_CORE_STATE_H
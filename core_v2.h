@@ -1,8 +1,71 @@
 #ifndef SALSA20_CORE_V2_H
 #define SALSA20_CORE_V2_H
 
+#include <aio.h>
 #include <stdint.h>
 
+#include "mtr_util.h"
+
 void salsa20_core_v2(uint32_t output[16], const uint32_t input[16]);
 
+void salsa20_core_v2_r12(uint32_t output[16], const uint32_t input[16]);
+
+void salsa20_core_v2_r8(uint32_t output[16], const uint32_t input[16]);
+
+#define SALSA_QROUND(a, b, c, d)(   \
+  b ^= ROTATELEFT(a + d, 7),        \
+  c ^= ROTATELEFT(b + a, 9),        \
+  d ^= ROTATELEFT(c + b, 13),       \
+  a ^= ROTATELEFT(d + c, 18))
+
+/*
+*   This core implementation uses SISD. It is different from v0 in that it
+*   doesn't transpose after every iteration. Instead, the positions of the
+*   elements are fixed. In the base implementation v0
+*   the matrix is transposed after four quarter-rounds (1 full round).
+*   As this would happen twice in here, we don't need to transpose at all,
+*   as transposing twice yields the original matrix. This is still valid,
+*   as the positions of the next four quarter rounds are adjusted accordingly.
+*
+*   The quarter round (macro) works by simply reordering the
+*   same expressions as v0.
+*
+*   rounds (20, 12 or 8) is a constant in every instantiation below, so the
+*   loop is unrolled completely.
+*/
+static inline __attribute__((always_inline)) void salsa20_core_v2_rounds(uint32_t output[16], const uint32_t input[16], const size_t rounds) {
+    for (size_t i = 0; i < 16; i++) {
+        output[i] = input[i];
+    }
+
+    #pragma GCC unroll 10
+    for (size_t i = 0; i < rounds / 2; i++) {
+        SALSA_QROUND(output[ 0], output[ 4], output[ 8], output[12]);
+        SALSA_QROUND(output[ 5], output[ 9], output[13], output[ 1]);
+        SALSA_QROUND(output[10], output[14], output[ 2], output[ 6]);
+        SALSA_QROUND(output[15], output[ 3], output[ 7], output[11]);
+
+        SALSA_QROUND(output[ 0], output[ 1], output[ 2], output[ 3]);
+        SALSA_QROUND(output[ 5], output[ 6], output[ 7], output[ 4]);
+        SALSA_QROUND(output[10], output[11], output[ 8], output[ 9]);
+        SALSA_QROUND(output[15], output[12], output[13], output[14]);
+    }
+
+    for (size_t i = 0; i < 16; i++) {
+        output[i] += input[i];
+    }
+}
+
+static inline __attribute__((always_inline)) void salsa20_core_v2_inline(uint32_t output[16], const uint32_t input[16]) {
+    salsa20_core_v2_rounds(output, input, 20);
+}
+
+static inline __attribute__((always_inline)) void salsa20_core_v2_inline_r12(uint32_t output[16], const uint32_t input[16]) {
+    salsa20_core_v2_rounds(output, input, 12);
+}
+
+static inline __attribute__((always_inline)) void salsa20_core_v2_inline_r8(uint32_t output[16], const uint32_t input[16]) {
+    salsa20_core_v2_rounds(output, input, 8);
+}
+
 #endif  // SALSA20_CORE_V2_H
@@ -0,0 +1,183 @@
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "core_pre.h"
+#include "mtr_util.h"
+
+// Salsa20 quarter round applied to sixteen word-sliced registers at once
+#define SALSA_QROUND_X16(a, b, c, d) {                                  \
+    b = _mm512_xor_si512(b, ROTL_AVX512(_mm512_add_epi32(a, d), 7));    \
+    c = _mm512_xor_si512(c, ROTL_AVX512(_mm512_add_epi32(b, a), 9));    \
+    d = _mm512_xor_si512(d, ROTL_AVX512(_mm512_add_epi32(c, b), 13));   \
+    a = _mm512_xor_si512(a, ROTL_AVX512(_mm512_add_epi32(d, c), 18));   \
+}
+
+/*  Transposes the 4x4 matrices of uint32_t's in all four 128 bit lanes of the
+*   rows r0 to r3 independently (see TRANSPOSE_X4 in core_x4.c).
+*/
+#define TRANSPOSE_X16_LANES(r0, r1, r2, r3) {       \
+    __m512i t0 = _mm512_unpacklo_epi32(r0, r1);     \
+    __m512i t1 = _mm512_unpacklo_epi32(r2, r3);     \
+    __m512i t2 = _mm512_unpackhi_epi32(r0, r1);     \
+    __m512i t3 = _mm512_unpackhi_epi32(r2, r3);     \
+    r0 = _mm512_unpacklo_epi64(t0, t1);             \
+    r1 = _mm512_unpackhi_epi64(t0, t1);             \
+    r2 = _mm512_unpacklo_epi64(t2, t3);             \
+    r3 = _mm512_unpackhi_epi64(t2, t3);             \
+}
+
+// Double rounds on the sixteen word-sliced matrices x[0] to x[15]
+__attribute__((target("avx512f")))
+static inline __attribute__((always_inline)) void salsa20_core_x16_double_rounds(__m512i x[16], const size_t double_rounds) {
+    #pragma GCC unroll 10
+    for (size_t i = 0; i < double_rounds; i++) {
+        // columns
+        SALSA_QROUND_X16(x[ 0], x[ 4], x[ 8], x[12]);
+        SALSA_QROUND_X16(x[ 5], x[ 9], x[13], x[ 1]);
+        SALSA_QROUND_X16(x[10], x[14], x[ 2], x[ 6]);
+        SALSA_QROUND_X16(x[15], x[ 3], x[ 7], x[11]);
+
+        // rows
+        SALSA_QROUND_X16(x[ 0], x[ 1], x[ 2], x[ 3]);
+        SALSA_QROUND_X16(x[ 5], x[ 6], x[ 7], x[ 4]);
+        SALSA_QROUND_X16(x[10], x[11], x[ 8], x[ 9]);
+        SALSA_QROUND_X16(x[15], x[12], x[13], x[14]);
+    }
+}
+
+// Adds the input to the state x and writes the sixteen blocks one after another
+__attribute__((target("avx512f")))
+static inline __attribute__((always_inline)) void salsa20_core_x16_store(uint32_t output[256], __m512i x[16], const __m512i in[16]) {
+    for (size_t i = 0; i < 16; i++) {
+        x[i] = _mm512_add_epi32(x[i], in[i]);
+    }
+
+    /*  After transposing the lanes, 128 bit lane k of x[4 * i + j] holds the words
+    *   4 * i to 4 * i + 3 of block 4 * k + j. Transposing the 128 bit lanes of
+    *   x[j], x[4 + j], x[8 + j] and x[12 + j] yields the blocks j, 4 + j, 8 + j
+    *   and 12 + j.
+    */
+    for (size_t i = 0; i < 4; i++) {
+        TRANSPOSE_X16_LANES(x[4 * i], x[4 * i + 1], x[4 * i + 2], x[4 * i + 3]);
+    }
+
+    for (size_t j = 0; j < 4; j++) {
+        __m512i t0 = _mm512_shuffle_i32x4(x[j], x[4 + j], 0x44);
+        __m512i t1 = _mm512_shuffle_i32x4(x[8 + j], x[12 + j], 0x44);
+        __m512i t2 = _mm512_shuffle_i32x4(x[j], x[4 + j], 0xee);
+        __m512i t3 = _mm512_shuffle_i32x4(x[8 + j], x[12 + j], 0xee);
+
+        _mm512_storeu_si512(output + 16 * j, _mm512_shuffle_i32x4(t0, t1, 0x88));
+        _mm512_storeu_si512(output + 16 * (4 + j), _mm512_shuffle_i32x4(t0, t1, 0xdd));
+        _mm512_storeu_si512(output + 16 * (8 + j), _mm512_shuffle_i32x4(t2, t3, 0x88));
+        _mm512_storeu_si512(output + 16 * (12 + j), _mm512_shuffle_i32x4(t2, t3, 0xdd));
+    }
+}
+
+
+/*  AVX-512 version of salsa20_core_x4. It generates sixteen consecutive salsa20
+*   blocks (1 KiB of key stream) per call by keeping word i of all sixteen
+*   blocks in the __m512i x[i]. The rotations are done with the native VPROLD
+*   instruction instead of the shift/shift/or sequence of ROTL_SIMD. The blocks
+*   are written to the output one after another, i.e. output[16 * j + i] is
+*   word i of block j.
+*
+*   The function is compiled for AVX-512F only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx512f")))
+static inline __attribute__((always_inline)) void salsa20_core_x16_rounds(uint32_t output[256], const uint32_t input[16], const size_t rounds) {
+    __m512i x[16];
+    __m512i in[16];
+
+    for (size_t i = 0; i < 16; i++) {
+        in[i] = _mm512_set1_epi32(input[i]);
+    }
+
+    // Counter of every lane (carry from low to high word included)
+    uint64_t counter = ((uint64_t) input[9] << 32) | input[8];
+    uint32_t c_lo[16];
+    uint32_t c_hi[16];
+    for (size_t j = 0; j < 16; j++) {
+        c_lo[j] = (counter + j) & 0xffffffff;
+        c_hi[j] = (counter + j) >> 32;
+    }
+    in[8] = _mm512_loadu_si512(c_lo);
+    in[9] = _mm512_loadu_si512(c_hi);
+
+    for (size_t i = 0; i < 16; i++) {
+        x[i] = in[i];
+    }
+
+    salsa20_core_x16_double_rounds(x, rounds / 2);
+    salsa20_core_x16_store(output, x, in);
+}
+
+// Salsa20/20, /12 and /8 instantiations of salsa20_core_x16_rounds
+__attribute__((target("avx512f")))
+void salsa20_core_x16(uint32_t output[256], const uint32_t input[16]) {
+    salsa20_core_x16_rounds(output, input, 20);
+}
+
+__attribute__((target("avx512f")))
+void salsa20_core_x16_r12(uint32_t output[256], const uint32_t input[16]) {
+    salsa20_core_x16_rounds(output, input, 12);
+}
+
+__attribute__((target("avx512f")))
+void salsa20_core_x16_r8(uint32_t output[256], const uint32_t input[16]) {
+    salsa20_core_x16_rounds(output, input, 8);
+}
+
+/*  salsa20_core_x16 starting from the precomputed part of the first double round (see
+*   salsa20_precompute and salsa20_core_x8_pre), counter must be at most 2^32 - 16.
+*
+*   The function is compiled for AVX-512F only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx512f")))
+static inline __attribute__((always_inline)) void salsa20_core_x16_pre_rounds(uint32_t output[256], const struct salsa20_precomp* pre, uint32_t counter, const size_t rounds) {
+    __m512i in[16];
+    __m512i x[16];
+
+    for (size_t i = 0; i < 16; i++) {
+        in[i] = _mm512_set1_epi32(pre->input[i]);
+        x[i] = _mm512_set1_epi32(pre->x[i]);
+    }
+    in[8] = _mm512_add_epi32(_mm512_set1_epi32(counter), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+    // Rest of column 0
+    __m512i x4_col = _mm512_set1_epi32(pre->x4_col);
+    x[8] = _mm512_xor_si512(in[8], _mm512_set1_epi32(pre->t8_col));
+    x[12] = _mm512_xor_si512(x[12], ROTL_AVX512(_mm512_add_epi32(x[8], x4_col), 13));
+    x[0] = _mm512_xor_si512(x[0], ROTL_AVX512(_mm512_add_epi32(x[12], x[8]), 18));
+
+    // Row 0 and the rest of rows 2 and 3
+    SALSA_QROUND_X16(x[ 0], x[ 1], x[ 2], x[ 3]);
+    x[8] = _mm512_xor_si512(x[8], _mm512_set1_epi32(pre->t8_row));
+    x[9] = _mm512_xor_si512(x[9], ROTL_AVX512(_mm512_add_epi32(x[8], x[11]), 13));
+    x[10] = _mm512_xor_si512(x[10], ROTL_AVX512(_mm512_add_epi32(x[9], x[8]), 18));
+    x[12] = _mm512_xor_si512(x[12], _mm512_set1_epi32(pre->t12_row));
+    x[13] = _mm512_xor_si512(x[13], ROTL_AVX512(_mm512_add_epi32(x[12], x[15]), 9));
+    x[14] = _mm512_xor_si512(x[14], ROTL_AVX512(_mm512_add_epi32(x[13], x[12]), 13));
+    x[15] = _mm512_xor_si512(x[15], ROTL_AVX512(_mm512_add_epi32(x[14], x[13]), 18));
+
+    salsa20_core_x16_double_rounds(x, rounds / 2 - 1);
+    salsa20_core_x16_store(output, x, in);
+}
+
+// Salsa20/20, /12 and /8 instantiations of salsa20_core_x16_pre_rounds
+__attribute__((target("avx512f")))
+void salsa20_core_x16_pre(uint32_t output[256], const struct salsa20_precomp* pre, uint32_t counter) {
+    salsa20_core_x16_pre_rounds(output, pre, counter, 20);
+}
+
+__attribute__((target("avx512f")))
+void salsa20_core_x16_pre_r12(uint32_t output[256], const struct salsa20_precomp* pre, uint32_t counter) {
+    salsa20_core_x16_pre_rounds(output, pre, counter, 12);
+}
+
+__attribute__((target("avx512f")))
+void salsa20_core_x16_pre_r8(uint32_t output[256], const struct salsa20_precomp* pre, uint32_t counter) {
+    salsa20_core_x16_pre_rounds(output, pre, counter, 8);
+}
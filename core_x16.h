@@ -0,0 +1,20 @@
+#ifndef SALSA20_CORE_X16_H
+#define SALSA20_CORE_X16_H
+
+#include <stdint.h>
+
+#include "core_pre.h"
+
+void salsa20_core_x16(uint32_t output[256], const uint32_t input[16]);
+
+void salsa20_core_x16_r12(uint32_t output[256], const uint32_t input[16]);
+
+void salsa20_core_x16_r8(uint32_t output[256], const uint32_t input[16]);
+
+void salsa20_core_x16_pre(uint32_t output[256], const struct salsa20_precomp* pre, uint32_t counter);
+
+void salsa20_core_x16_pre_r12(uint32_t output[256], const struct salsa20_precomp* pre, uint32_t counter);
+
+void salsa20_core_x16_pre_r8(uint32_t output[256], const struct salsa20_precomp* pre, uint32_t counter);
+
+#endif  // SALSA20_CORE_X16_H
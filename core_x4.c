@@ -0,0 +1,154 @@
+#include <stdint.h>
+#include <emmintrin.h>
+
+#include "mtr_util.h"
+
+// Salsa20 quarter round applied to four word-sliced registers at once
+#define SALSA_QROUND_X4(a, b, c, d) {                       \
+    b = _mm_xor_si128(b, ROTL_SIMD(_mm_add_epi32(a, d), 7));  \
+    c = _mm_xor_si128(c, ROTL_SIMD(_mm_add_epi32(b, a), 9));  \
+    d = _mm_xor_si128(d, ROTL_SIMD(_mm_add_epi32(c, b), 13)); \
+    a = _mm_xor_si128(a, ROTL_SIMD(_mm_add_epi32(d, c), 18)); \
+}
+
+/*  Transposes the 4x4 matrix of uint32_t's given by the rows r0 to r3, such
+*   that afterwards r0 holds the first lane of every input row, r1 the second
+*   lane and so on.
+*/
+#define TRANSPOSE_X4(r0, r1, r2, r3) {          \
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);    \
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);    \
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);    \
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);    \
+    r0 = _mm_unpacklo_epi64(t0, t1);            \
+    r1 = _mm_unpackhi_epi64(t0, t1);            \
+    r2 = _mm_unpacklo_epi64(t2, t3);            \
+    r3 = _mm_unpackhi_epi64(t2, t3);            \
+}
+
+/*  Runs the given number of rounds on the four word-sliced matrices in[0] to in[15],
+*   adds the input and writes the four blocks to the output one after another (shared by
+*   salsa20_core_x4 and salsa20_core_x4_lanes).
+*/
+static inline __attribute__((always_inline)) void salsa20_core_x4_sliced(uint32_t output[64], const __m128i in[16], const size_t rounds) {
+    __m128i x[16];
+
+    for (size_t i = 0; i < 16; i++) {
+        x[i] = in[i];
+    }
+
+    #pragma GCC unroll 10
+    for (size_t i = 0; i < rounds / 2; i++) {
+        // columns
+        SALSA_QROUND_X4(x[ 0], x[ 4], x[ 8], x[12]);
+        SALSA_QROUND_X4(x[ 5], x[ 9], x[13], x[ 1]);
+        SALSA_QROUND_X4(x[10], x[14], x[ 2], x[ 6]);
+        SALSA_QROUND_X4(x[15], x[ 3], x[ 7], x[11]);
+
+        // rows
+        SALSA_QROUND_X4(x[ 0], x[ 1], x[ 2], x[ 3]);
+        SALSA_QROUND_X4(x[ 5], x[ 6], x[ 7], x[ 4]);
+        SALSA_QROUND_X4(x[10], x[11], x[ 8], x[ 9]);
+        SALSA_QROUND_X4(x[15], x[12], x[13], x[14]);
+    }
+
+    for (size_t i = 0; i < 16; i++) {
+        x[i] = _mm_add_epi32(x[i], in[i]);
+    }
+
+    // Transpose every group of four words back into the four blocks
+    __m128i_u* out_ptr = (__m128i_u*) output;
+    for (size_t i = 0; i < 4; i++) {
+        TRANSPOSE_X4(x[4 * i], x[4 * i + 1], x[4 * i + 2], x[4 * i + 3]);
+
+        _mm_storeu_si128(out_ptr + i, x[4 * i]);
+        _mm_storeu_si128(out_ptr + 4 + i, x[4 * i + 1]);
+        _mm_storeu_si128(out_ptr + 8 + i, x[4 * i + 2]);
+        _mm_storeu_si128(out_ptr + 12 + i, x[4 * i + 3]);
+    }
+}
+
+/*  This core implementation generates four consecutive salsa20 blocks
+*   (256 bytes of key stream) per call. Instead of keeping one block in four
+*   registers like v3, the matrices are stored "word-sliced": x[i] holds
+*   word i of all four blocks, one block per lane. Every lane therefore runs
+*   the plain SISD algorithm of v2 on its own block and no shuffling is
+*   needed between the row and column rounds. The blocks only differ in the
+*   counter (words 8 and 9), which is incremented by one per lane.
+*   The four blocks are transposed back at the end and written to the output
+*   one after another, i.e. output[16 * j + i] is word i of block j.
+*/
+static inline __attribute__((always_inline)) void salsa20_core_x4_rounds(uint32_t output[64], const uint32_t input[16], const size_t rounds) {
+    __m128i in[16];
+
+    for (size_t i = 0; i < 16; i++) {
+        in[i] = _mm_set1_epi32(input[i]);
+    }
+
+    // Counter of every lane (carry from low to high word included)
+    uint64_t counter = ((uint64_t) input[9] << 32) | input[8];
+    uint32_t c_lo[4];
+    uint32_t c_hi[4];
+    for (size_t j = 0; j < 4; j++) {
+        c_lo[j] = (counter + j) & 0xffffffff;
+        c_hi[j] = (counter + j) >> 32;
+    }
+    in[8] = _mm_setr_epi32(c_lo[0], c_lo[1], c_lo[2], c_lo[3]);
+    in[9] = _mm_setr_epi32(c_hi[0], c_hi[1], c_hi[2], c_hi[3]);
+
+    salsa20_core_x4_sliced(output, in, rounds);
+}
+
+// Salsa20/20, /12 and /8 instantiations of salsa20_core_x4_rounds
+void salsa20_core_x4(uint32_t output[64], const uint32_t input[16]) {
+    salsa20_core_x4_rounds(output, input, 20);
+}
+
+void salsa20_core_x4_r12(uint32_t output[64], const uint32_t input[16]) {
+    salsa20_core_x4_rounds(output, input, 12);
+}
+
+void salsa20_core_x4_r8(uint32_t output[64], const uint32_t input[16]) {
+    salsa20_core_x4_rounds(output, input, 8);
+}
+
+/*  Variant of salsa20_core_x4 whose lanes are independent of each other: lane j
+*   generates the block with counter counters[j] of the key stream for the nonce
+*   ivs[j]. Only the key and the constants are shared, so blocks of four different
+*   messages (or four arbitrary blocks of one message) can be generated at once.
+*   output[16 * j + i] is word i of the block of lane j.
+*/
+void salsa20_core_x4_lanes(uint32_t output[64], const uint32_t key[8], const uint64_t ivs[4], const uint64_t counters[4]) {
+    __m128i in[16];
+
+    in[0] = _mm_set1_epi32(0x61707865);
+    in[5] = _mm_set1_epi32(0x3320646e);
+    in[10] = _mm_set1_epi32(0x79622d32);
+    in[15] = _mm_set1_epi32(0x6b206574);
+
+    for (size_t i = 0; i < 4; i++) {
+        in[1 + i] = _mm_set1_epi32(key[i]);
+        in[11 + i] = _mm_set1_epi32(key[4 + i]);
+    }
+
+    in[6] = _mm_setr_epi32(ivs[0], ivs[1], ivs[2], ivs[3]);
+    in[7] = _mm_setr_epi32(ivs[0] >> 32, ivs[1] >> 32, ivs[2] >> 32, ivs[3] >> 32);
+    in[8] = _mm_setr_epi32(counters[0], counters[1], counters[2], counters[3]);
+    in[9] = _mm_setr_epi32(counters[0] >> 32, counters[1] >> 32, counters[2] >> 32, counters[3] >> 32);
+
+    salsa20_core_x4_sliced(output, in, 20);
+}
+
+/*  Multi-buffer variant of salsa20_core_x4: every lane has its own input matrix
+*   inputs[j] (key, nonce and counter), so four unrelated streams advance at once.
+*   output[16 * j + i] is word i of the block of lane j.
+*/
+void salsa20_core_x4_multi(uint32_t output[64], const uint32_t inputs[4][16]) {
+    __m128i in[16];
+
+    for (size_t i = 0; i < 16; i++) {
+        in[i] = _mm_setr_epi32(inputs[0][i], inputs[1][i], inputs[2][i], inputs[3][i]);
+    }
+
+    salsa20_core_x4_sliced(output, in, 20);
+}
@@ -0,0 +1,16 @@
+#ifndef SALSA20_CORE_X4_H
+#define SALSA20_CORE_X4_H
+
+#include <stdint.h>
+
+void salsa20_core_x4(uint32_t output[64], const uint32_t input[16]);
+
+void salsa20_core_x4_r12(uint32_t output[64], const uint32_t input[16]);
+
+void salsa20_core_x4_r8(uint32_t output[64], const uint32_t input[16]);
+
+void salsa20_core_x4_lanes(uint32_t output[64], const uint32_t key[8], const uint64_t ivs[4], const uint64_t counters[4]);
+
+void salsa20_core_x4_multi(uint32_t output[64], const uint32_t inputs[4][16]);
+
+#endif  // SALSA20_CORE_X4_H
@@ -0,0 +1,241 @@
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "core_pre.h"
+#include "mtr_util.h"
+
+// Salsa20 quarter round applied to eight word-sliced registers at once
+#define SALSA_QROUND_X8(a, b, c, d) {                               \
+    b = _mm256_xor_si256(b, ROTL_AVX2(_mm256_add_epi32(a, d), 7));  \
+    c = _mm256_xor_si256(c, ROTL_AVX2(_mm256_add_epi32(b, a), 9));  \
+    d = _mm256_xor_si256(d, ROTL_AVX2(_mm256_add_epi32(c, b), 13)); \
+    a = _mm256_xor_si256(a, ROTL_AVX2(_mm256_add_epi32(d, c), 18)); \
+}
+
+/*  Transposes the 4x4 matrices of uint32_t's in both 128 bit halves of the rows
+*   r0 to r3 independently (see TRANSPOSE_X4 in core_x4.c).
+*/
+#define TRANSPOSE_X8_HALVES(r0, r1, r2, r3) {       \
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);     \
+    __m256i t1 = _mm256_unpacklo_epi32(r2, r3);     \
+    __m256i t2 = _mm256_unpackhi_epi32(r0, r1);     \
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);     \
+    r0 = _mm256_unpacklo_epi64(t0, t1);             \
+    r1 = _mm256_unpackhi_epi64(t0, t1);             \
+    r2 = _mm256_unpacklo_epi64(t2, t3);             \
+    r3 = _mm256_unpackhi_epi64(t2, t3);             \
+}
+
+// Double rounds on the eight word-sliced matrices x[0] to x[15]
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline)) void salsa20_core_x8_double_rounds(__m256i x[16], const size_t double_rounds) {
+    #pragma GCC unroll 10
+    for (size_t i = 0; i < double_rounds; i++) {
+        // columns
+        SALSA_QROUND_X8(x[ 0], x[ 4], x[ 8], x[12]);
+        SALSA_QROUND_X8(x[ 5], x[ 9], x[13], x[ 1]);
+        SALSA_QROUND_X8(x[10], x[14], x[ 2], x[ 6]);
+        SALSA_QROUND_X8(x[15], x[ 3], x[ 7], x[11]);
+
+        // rows
+        SALSA_QROUND_X8(x[ 0], x[ 1], x[ 2], x[ 3]);
+        SALSA_QROUND_X8(x[ 5], x[ 6], x[ 7], x[ 4]);
+        SALSA_QROUND_X8(x[10], x[11], x[ 8], x[ 9]);
+        SALSA_QROUND_X8(x[15], x[12], x[13], x[14]);
+    }
+}
+
+// Adds the input to the state x and writes the eight blocks one after another
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline)) void salsa20_core_x8_store(uint32_t output[128], __m256i x[16], const __m256i in[16]) {
+    for (size_t i = 0; i < 16; i++) {
+        x[i] = _mm256_add_epi32(x[i], in[i]);
+    }
+
+    /*  After transposing the halves, x[4 * i + j] holds four words of block j in
+    *   its lower and four words of block j + 4 in its upper half. Combining the
+    *   halves of two such registers yields eight consecutive words of one block.
+    */
+    for (size_t i = 0; i < 4; i++) {
+        TRANSPOSE_X8_HALVES(x[4 * i], x[4 * i + 1], x[4 * i + 2], x[4 * i + 3]);
+    }
+
+    __m256i_u* out_ptr = (__m256i_u*) output;
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            __m256i lo = x[8 * i + j];
+            __m256i hi = x[8 * i + 4 + j];
+            _mm256_storeu_si256(out_ptr + 2 * j + i, _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256(out_ptr + 2 * (j + 4) + i, _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+    }
+}
+
+/*  Runs the given number of rounds on the eight word-sliced matrices in[0] to in[15],
+*   adds the input and writes the eight blocks to the output one after another (shared by
+*   salsa20_core_x8 and salsa20_core_x8_lanes).
+*/
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline)) void salsa20_core_x8_sliced(uint32_t output[128], const __m256i in[16], const size_t rounds) {
+    __m256i x[16];
+
+    for (size_t i = 0; i < 16; i++) {
+        x[i] = in[i];
+    }
+
+    salsa20_core_x8_double_rounds(x, rounds / 2);
+    salsa20_core_x8_store(output, x, in);
+}
+
+/*  AVX2 version of salsa20_core_x4. It generates eight consecutive salsa20
+*   blocks (512 bytes of key stream) per call by keeping word i of all eight
+*   blocks in the __m256i x[i]. The blocks are written to the output one after
+*   another, i.e. output[16 * j + i] is word i of block j.
+*
+*   The function is compiled for AVX2 only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline)) void salsa20_core_x8_rounds(uint32_t output[128], const uint32_t input[16], const size_t rounds) {
+    __m256i in[16];
+
+    for (size_t i = 0; i < 16; i++) {
+        in[i] = _mm256_set1_epi32(input[i]);
+    }
+
+    // Counter of every lane (carry from low to high word included)
+    uint64_t counter = ((uint64_t) input[9] << 32) | input[8];
+    uint32_t c_lo[8];
+    uint32_t c_hi[8];
+    for (size_t j = 0; j < 8; j++) {
+        c_lo[j] = (counter + j) & 0xffffffff;
+        c_hi[j] = (counter + j) >> 32;
+    }
+    in[8] = _mm256_loadu_si256((__m256i_u*) c_lo);
+    in[9] = _mm256_loadu_si256((__m256i_u*) c_hi);
+
+    salsa20_core_x8_sliced(output, in, rounds);
+}
+
+// Salsa20/20, /12 and /8 instantiations of salsa20_core_x8_rounds
+__attribute__((target("avx2")))
+void salsa20_core_x8(uint32_t output[128], const uint32_t input[16]) {
+    salsa20_core_x8_rounds(output, input, 20);
+}
+
+__attribute__((target("avx2")))
+void salsa20_core_x8_r12(uint32_t output[128], const uint32_t input[16]) {
+    salsa20_core_x8_rounds(output, input, 12);
+}
+
+__attribute__((target("avx2")))
+void salsa20_core_x8_r8(uint32_t output[128], const uint32_t input[16]) {
+    salsa20_core_x8_rounds(output, input, 8);
+}
+
+/*  AVX2 version of salsa20_core_x4_lanes: lane j generates the block with counter
+*   counters[j] of the key stream for the nonce ivs[j] under the shared key.
+*
+*   The function is compiled for AVX2 only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx2")))
+void salsa20_core_x8_lanes(uint32_t output[128], const uint32_t key[8], const uint64_t ivs[8], const uint64_t counters[8]) {
+    __m256i in[16];
+    uint32_t words[4][8];
+
+    in[0] = _mm256_set1_epi32(0x61707865);
+    in[5] = _mm256_set1_epi32(0x3320646e);
+    in[10] = _mm256_set1_epi32(0x79622d32);
+    in[15] = _mm256_set1_epi32(0x6b206574);
+
+    for (size_t i = 0; i < 4; i++) {
+        in[1 + i] = _mm256_set1_epi32(key[i]);
+        in[11 + i] = _mm256_set1_epi32(key[4 + i]);
+    }
+
+    for (size_t j = 0; j < 8; j++) {
+        words[0][j] = ivs[j] & 0xffffffff;
+        words[1][j] = ivs[j] >> 32;
+        words[2][j] = counters[j] & 0xffffffff;
+        words[3][j] = counters[j] >> 32;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        in[6 + i] = _mm256_loadu_si256((__m256i_u*) words[i]);
+    }
+
+    salsa20_core_x8_sliced(output, in, 20);
+}
+
+/*  AVX2 version of salsa20_core_x4_multi: lane j computes the block of its own
+*   input matrix inputs[j].
+*
+*   The function is compiled for AVX2 only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx2")))
+void salsa20_core_x8_multi(uint32_t output[128], const uint32_t inputs[8][16]) {
+    __m256i in[16];
+    __m256i idx = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+
+    // Word i of all lanes is 16 words apart
+    for (size_t i = 0; i < 16; i++) {
+        in[i] = _mm256_i32gather_epi32((const int*) &inputs[0][i], idx, 4);
+    }
+
+    salsa20_core_x8_sliced(output, in, 20);
+}
+
+/*  salsa20_core_x8 starting from the precomputed part of the first double round (see
+*   salsa20_precompute): the eight blocks have the counters (high word of pre->input,
+*   counter) to (high word, counter + 7), so counter must be at most 2^32 - 8.
+*
+*   The function is compiled for AVX2 only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline)) void salsa20_core_x8_pre_rounds(uint32_t output[128], const struct salsa20_precomp* pre, uint32_t counter, const size_t rounds) {
+    __m256i in[16];
+    __m256i x[16];
+
+    for (size_t i = 0; i < 16; i++) {
+        in[i] = _mm256_set1_epi32(pre->input[i]);
+        x[i] = _mm256_set1_epi32(pre->x[i]);
+    }
+    in[8] = _mm256_add_epi32(_mm256_set1_epi32(counter), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    // Rest of column 0
+    __m256i x4_col = _mm256_set1_epi32(pre->x4_col);
+    x[8] = _mm256_xor_si256(in[8], _mm256_set1_epi32(pre->t8_col));
+    x[12] = _mm256_xor_si256(x[12], ROTL_AVX2(_mm256_add_epi32(x[8], x4_col), 13));
+    x[0] = _mm256_xor_si256(x[0], ROTL_AVX2(_mm256_add_epi32(x[12], x[8]), 18));
+
+    // Row 0 and the rest of rows 2 and 3
+    SALSA_QROUND_X8(x[ 0], x[ 1], x[ 2], x[ 3]);
+    x[8] = _mm256_xor_si256(x[8], _mm256_set1_epi32(pre->t8_row));
+    x[9] = _mm256_xor_si256(x[9], ROTL_AVX2(_mm256_add_epi32(x[8], x[11]), 13));
+    x[10] = _mm256_xor_si256(x[10], ROTL_AVX2(_mm256_add_epi32(x[9], x[8]), 18));
+    x[12] = _mm256_xor_si256(x[12], _mm256_set1_epi32(pre->t12_row));
+    x[13] = _mm256_xor_si256(x[13], ROTL_AVX2(_mm256_add_epi32(x[12], x[15]), 9));
+    x[14] = _mm256_xor_si256(x[14], ROTL_AVX2(_mm256_add_epi32(x[13], x[12]), 13));
+    x[15] = _mm256_xor_si256(x[15], ROTL_AVX2(_mm256_add_epi32(x[14], x[13]), 18));
+
+    salsa20_core_x8_double_rounds(x, rounds / 2 - 1);
+    salsa20_core_x8_store(output, x, in);
+}
+
+// Salsa20/20, /12 and /8 instantiations of salsa20_core_x8_pre_rounds
+__attribute__((target("avx2")))
+void salsa20_core_x8_pre(uint32_t output[128], const struct salsa20_precomp* pre, uint32_t counter) {
+    salsa20_core_x8_pre_rounds(output, pre, counter, 20);
+}
+
+__attribute__((target("avx2")))
+void salsa20_core_x8_pre_r12(uint32_t output[128], const struct salsa20_precomp* pre, uint32_t counter) {
+    salsa20_core_x8_pre_rounds(output, pre, counter, 12);
+}
+
+__attribute__((target("avx2")))
+void salsa20_core_x8_pre_r8(uint32_t output[128], const struct salsa20_precomp* pre, uint32_t counter) {
+    salsa20_core_x8_pre_rounds(output, pre, counter, 8);
+}
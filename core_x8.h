@@ -0,0 +1,24 @@
+#ifndef SALSA20_CORE_X8_H
+#define SALSA20_CORE_X8_H
+
+#include <stdint.h>
+
+#include "core_pre.h"
+
+void salsa20_core_x8(uint32_t output[128], const uint32_t input[16]);
+
+void salsa20_core_x8_r12(uint32_t output[128], const uint32_t input[16]);
+
+void salsa20_core_x8_r8(uint32_t output[128], const uint32_t input[16]);
+
+void salsa20_core_x8_lanes(uint32_t output[128], const uint32_t key[8], const uint64_t ivs[8], const uint64_t counters[8]);
+
+void salsa20_core_x8_multi(uint32_t output[128], const uint32_t inputs[8][16]);
+
+void salsa20_core_x8_pre(uint32_t output[128], const struct salsa20_precomp* pre, uint32_t counter);
+
+void salsa20_core_x8_pre_r12(uint32_t output[128], const struct salsa20_precomp* pre, uint32_t counter);
+
+void salsa20_core_x8_pre_r8(uint32_t output[128], const struct salsa20_precomp* pre, uint32_t counter);
+
+#endif  // SALSA20_CORE_X8_H
@@ -0,0 +1,262 @@
+#include <aio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <immintrin.h>
+
+#include "crypt_nt.h"
+
+// Fallback for the threshold if the size of the last level cache is unknown
+#define NT_DEFAULT_THRESHOLD (8 << 20)
+
+/*  Threshold set with salsa20_set_nt_threshold (0: automatic) and the calibrated one.
+*   The crypt implementations read them from every thread, nt_threshold is accessed
+*   atomically and nt_calibrated is computed once with pthread_once.
+*/
+static size_t nt_threshold = 0;
+static size_t nt_calibrated = 0;
+static pthread_once_t nt_once = PTHREAD_ONCE_INIT;
+
+static void salsa20_nt_calibrate(void) {
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc <= 0) {
+        llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    }
+    nt_calibrated = llc > 0 ? (size_t) llc : NT_DEFAULT_THRESHOLD;
+}
+
+/*  Messages of at least this many bytes are written with non-temporal stores by the
+*   SIMD crypt implementations. Unless it was set with salsa20_set_nt_threshold, the
+*   threshold is the size of the last level cache: the cipher text of a larger
+*   message can not stay in the cache anyway, and with regular stores every line of it
+*   would first be read from memory (read for ownership) and then evict useful data.
+*/
+size_t salsa20_nt_threshold(void) {
+    size_t threshold = __atomic_load_n(&nt_threshold, __ATOMIC_RELAXED);
+
+    if (threshold) {
+        return threshold;
+    }
+    pthread_once(&nt_once, salsa20_nt_calibrate);
+    return nt_calibrated;
+}
+
+// Sets the threshold in bytes, SIZE_MAX turns the non-temporal stores off and 0 selects the calibrated one again
+void salsa20_set_nt_threshold(size_t threshold) {
+    __atomic_store_n(&nt_threshold, threshold, __ATOMIC_RELAXED);
+}
+
+// Input matrix for the block with the given counter
+static inline void salsa20_nt_input(uint32_t input[16], const uint32_t key[8], uint64_t iv, uint64_t counter) {
+    input[0] = 0x61707865;
+    input[5] = 0x3320646e;
+    input[10] = 0x79622d32;
+    input[15] = 0x6b206574;
+    for (size_t i = 0; i < 4; i++) {
+        input[1 + i] = key[i];
+        input[11 + i] = key[4 + i];
+    }
+    input[6] = iv & 0xffffffff;
+    input[7] = iv >> 32;
+    input[8] = counter & 0xffffffff;
+    input[9] = counter >> 32;
+}
+
+/*  Bulk path with non-temporal stores for the SSE2 crypt implementations. _mm_stream_si128
+*   needs a 16 byte aligned destination, which in general is not aligned with the blocks
+*   of the key stream. So the key stream is kept in a window of five blocks: key_stream[0]
+*   is the block that contains the key stream byte of the current position (index k),
+*   key_stream[1..4] the following four blocks from the wide core (salsa20_core_x4
+*   or its reduced round versions). 256 bytes are
+*   encrypted per iteration with unaligned loads from the window, then the last block
+*   moves to the front and four new blocks are generated behind it.
+*
+*   First the up to 15 bytes until the cipher text is aligned are encrypted via SISD.
+*   The function stops at a block boundary of the key stream (or at the end of the
+*   message), so the caller can continue with whole blocks, and returns the number of
+*   bytes it has encrypted (0 if the message is too short).
+*/
+size_t salsa20_crypt_nt_x4(size_t mlen, const uint8_t msg[], uint8_t cipher[], const uint32_t key[8], uint64_t iv, uint64_t offset, core_func wide) {
+    size_t pre = (-(uintptr_t) cipher) & 15;
+
+    if (mlen < pre + 256) {
+        return 0;
+    }
+
+    uint32_t key_stream[80] __attribute__((aligned(64)));
+    uint32_t scratch[64] __attribute__((aligned(64)));
+    uint32_t input[16];
+    uint8_t* key_byte_stream = (uint8_t*) key_stream;
+
+    // The prefix lies within the first two blocks of the key stream
+    salsa20_nt_input(input, key, iv, offset / 64);
+    wide(scratch, input);
+    for (size_t i = 0; i < pre; i++) {
+        cipher[i] = msg[i] ^ ((uint8_t*) scratch)[offset % 64 + i];
+    }
+
+    size_t n = pre;
+    uint64_t base = (offset + n) / 64;
+    size_t k = (offset + n) % 64;
+
+    salsa20_nt_input(input, key, iv, base);
+    wide(key_stream, input);
+    salsa20_nt_input(input, key, iv, base + 4);
+    wide(scratch, input);
+    memcpy(key_stream + 64, scratch, 64);
+
+    while (mlen - n >= 256) {
+        for (size_t i = 0; i < 16; i++) {
+            __m128i msg_vec = _mm_loadu_si128((const __m128i_u*) (msg + n) + i);
+            __m128i key_stream_vec = _mm_loadu_si128((const __m128i_u*) (key_byte_stream + k) + i);
+            _mm_stream_si128((__m128i*) (cipher + n) + i, _mm_xor_si128(msg_vec, key_stream_vec));
+        }
+        n += 256;
+        base += 4;
+
+        memcpy(key_stream, key_stream + 64, 64);
+        salsa20_nt_input(input, key, iv, base + 1);
+        wide(key_stream + 16, input);
+    }
+
+    // Make the non-temporal stores visible before the caller continues with regular ones
+    _mm_sfence();
+
+    // Rest of the current block, key_stream[0] still holds it
+    while (k && k < 64 && n < mlen) {
+        cipher[n] = msg[n] ^ key_byte_stream[k];
+        k++;
+        n++;
+    }
+
+    return n;
+}
+
+/*  AVX2 version of salsa20_crypt_nt_x4 with _mm256_stream_si256: the window holds
+*   nine blocks, 512 bytes are encrypted per iteration and the eight new blocks come
+*   from salsa20_core_x8.
+*
+*   The function is compiled for AVX2 only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx2")))
+size_t salsa20_crypt_nt_x8(size_t mlen, const uint8_t msg[], uint8_t cipher[], const uint32_t key[8], uint64_t iv, uint64_t offset, core_func wide) {
+    size_t pre = (-(uintptr_t) cipher) & 31;
+
+    if (mlen < pre + 512) {
+        return 0;
+    }
+
+    uint32_t key_stream[144] __attribute__((aligned(64)));
+    uint32_t scratch[128] __attribute__((aligned(64)));
+    uint32_t input[16];
+    uint8_t* key_byte_stream = (uint8_t*) key_stream;
+
+    // The prefix lies within the first two blocks of the key stream
+    salsa20_nt_input(input, key, iv, offset / 64);
+    wide(scratch, input);
+    for (size_t i = 0; i < pre; i++) {
+        cipher[i] = msg[i] ^ ((uint8_t*) scratch)[offset % 64 + i];
+    }
+
+    size_t n = pre;
+    uint64_t base = (offset + n) / 64;
+    size_t k = (offset + n) % 64;
+
+    salsa20_nt_input(input, key, iv, base);
+    wide(key_stream, input);
+    salsa20_nt_input(input, key, iv, base + 8);
+    wide(scratch, input);
+    memcpy(key_stream + 128, scratch, 64);
+
+    while (mlen - n >= 512) {
+        for (size_t i = 0; i < 16; i++) {
+            __m256i msg_vec = _mm256_loadu_si256((const __m256i_u*) (msg + n) + i);
+            __m256i key_stream_vec = _mm256_loadu_si256((const __m256i_u*) (key_byte_stream + k) + i);
+            _mm256_stream_si256((__m256i*) (cipher + n) + i, _mm256_xor_si256(msg_vec, key_stream_vec));
+        }
+        n += 512;
+        base += 8;
+
+        memcpy(key_stream, key_stream + 128, 64);
+        salsa20_nt_input(input, key, iv, base + 1);
+        wide(key_stream + 16, input);
+    }
+
+    // Make the non-temporal stores visible before the caller continues with regular ones
+    _mm_sfence();
+
+    // Rest of the current block, key_stream[0] still holds it
+    while (k && k < 64 && n < mlen) {
+        cipher[n] = msg[n] ^ key_byte_stream[k];
+        k++;
+        n++;
+    }
+
+    return n;
+}
+
+/*  AVX-512 version of salsa20_crypt_nt_x4 with _mm512_stream_si512: the window holds
+*   seventeen blocks, 1 KiB is encrypted per iteration and the sixteen new blocks come
+*   from salsa20_core_x16.
+*
+*   The function is compiled for AVX-512F only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx512f")))
+size_t salsa20_crypt_nt_x16(size_t mlen, const uint8_t msg[], uint8_t cipher[], const uint32_t key[8], uint64_t iv, uint64_t offset, core_func wide) {
+    size_t pre = (-(uintptr_t) cipher) & 63;
+
+    if (mlen < pre + 1024) {
+        return 0;
+    }
+
+    uint32_t key_stream[272] __attribute__((aligned(64)));
+    uint32_t scratch[256] __attribute__((aligned(64)));
+    uint32_t input[16];
+    uint8_t* key_byte_stream = (uint8_t*) key_stream;
+
+    // The prefix lies within the first two blocks of the key stream
+    salsa20_nt_input(input, key, iv, offset / 64);
+    wide(scratch, input);
+    for (size_t i = 0; i < pre; i++) {
+        cipher[i] = msg[i] ^ ((uint8_t*) scratch)[offset % 64 + i];
+    }
+
+    size_t n = pre;
+    uint64_t base = (offset + n) / 64;
+    size_t k = (offset + n) % 64;
+
+    salsa20_nt_input(input, key, iv, base);
+    wide(key_stream, input);
+    salsa20_nt_input(input, key, iv, base + 16);
+    wide(scratch, input);
+    memcpy(key_stream + 256, scratch, 64);
+
+    while (mlen - n >= 1024) {
+        for (size_t i = 0; i < 16; i++) {
+            __m512i msg_vec = _mm512_loadu_si512(msg + n + 64 * i);
+            __m512i key_stream_vec = _mm512_loadu_si512(key_byte_stream + k + 64 * i);
+            _mm512_stream_si512((__m512i*) (cipher + n) + i, _mm512_xor_si512(msg_vec, key_stream_vec));
+        }
+        n += 1024;
+        base += 16;
+
+        memcpy(key_stream, key_stream + 256, 64);
+        salsa20_nt_input(input, key, iv, base + 1);
+        wide(key_stream + 16, input);
+    }
+
+    // Make the non-temporal stores visible before the caller continues with regular ones
+    _mm_sfence();
+
+    // Rest of the current block, key_stream[0] still holds it
+    while (k && k < 64 && n < mlen) {
+        cipher[n] = msg[n] ^ key_byte_stream[k];
+        k++;
+        n++;
+    }
+
+    return n;
+}
@@ -0,0 +1,19 @@
+#ifndef SALSA20_CRYPT_NT_H
+#define SALSA20_CRYPT_NT_H
+
+#include <aio.h>
+#include <stdint.h>
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+
+size_t salsa20_nt_threshold(void);
+
+void salsa20_set_nt_threshold(size_t threshold);
+
+size_t salsa20_crypt_nt_x4(size_t mlen, const uint8_t msg[], uint8_t cipher[], const uint32_t key[8], uint64_t iv, uint64_t offset, core_func wide);
+
+size_t salsa20_crypt_nt_x8(size_t mlen, const uint8_t msg[], uint8_t cipher[], const uint32_t key[8], uint64_t iv, uint64_t offset, core_func wide);
+
+size_t salsa20_crypt_nt_x16(size_t mlen, const uint8_t msg[], uint8_t cipher[], const uint32_t key[8], uint64_t iv, uint64_t offset, core_func wide);
+
+#endif  // SALSA20_CRYPT_NT_H
@@ -0,0 +1,104 @@
+#include <aio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "crypt_parallel.h"
+#include "threadpool.h"
+
+// Messages are only split into spans of at least this many bytes
+#define MIN_SPAN_SIZE (64 * 1024)
+
+// Pool and crypt implementation used by salsa20_crypt_parallel (set by salsa20_parallel_init)
+static struct threadpool* parallel_pool = NULL;
+static crypt_func parallel_crypt = NULL;
+
+struct parallel_job {
+    size_t mlen;
+    const uint8_t* msg;
+    uint8_t* cipher;
+    uint32_t* key;
+    uint64_t iv;
+    uint64_t offset;
+    core_func core;
+    size_t span;
+    size_t nspans;
+};
+
+/*  Start of span i within the message. Spans start at block boundaries of the key
+*   stream, so every span begins with a fresh counter value.
+*/
+static size_t span_start(const struct parallel_job* job, size_t i) {
+    if (i == 0) {
+        return 0;
+    }
+    if (i >= job->nspans) {
+        return job->mlen;
+    }
+
+    uint64_t pos = (job->offset + i * job->span + 63) & ~(uint64_t) 63;
+    uint64_t start = pos - job->offset;
+    return start < job->mlen ? start : job->mlen;
+}
+
+static void parallel_task(void* arg, size_t i) {
+    const struct parallel_job* job = arg;
+    size_t start = span_start(job, i);
+    size_t end = span_start(job, i + 1);
+
+    if (start < end) {
+        parallel_crypt(end - start, job->msg + start, job->cipher + start, job->key, job->iv, job->offset + start, job->core);
+    }
+}
+
+/*  Creates the persistent pool of nthreads threads that is used by salsa20_crypt_parallel
+*   and sets the crypt implementation that every thread runs on its span. Returns 0 on
+*   success.
+*/
+int salsa20_parallel_init(size_t nthreads, crypt_func crypt) {
+    salsa20_parallel_destroy();
+
+    if (!(parallel_pool = threadpool_create(nthreads))) {
+        return -1;
+    }
+
+    parallel_crypt = crypt;
+    return 0;
+}
+
+void salsa20_parallel_destroy(void) {
+    threadpool_destroy(parallel_pool);
+    parallel_pool = NULL;
+}
+
+/*  This crypt implementation splits the message into one span per thread of the pool.
+*   Since salsa20 blocks are independent of each other, every thread encrypts its span
+*   with the crypt implementation given to salsa20_parallel_init, starting at the key
+*   stream offset of the span. The result is identical to a single threaded call.
+*   Short messages are encrypted on the calling thread only.
+*/
+void salsa20_crypt_parallel(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core) {
+    size_t nspans = parallel_pool ? threadpool_size(parallel_pool) : 1;
+
+    if (nspans > mlen / MIN_SPAN_SIZE) {
+        nspans = mlen / MIN_SPAN_SIZE;
+    }
+
+    if (nspans <= 1) {
+        parallel_crypt(mlen, msg, cipher, key, iv, offset, core);
+        return;
+    }
+
+    struct parallel_job job = {
+        .mlen = mlen,
+        .msg = msg,
+        .cipher = cipher,
+        .key = key,
+        .iv = iv,
+        .offset = offset,
+        .core = core,
+        .span = (mlen + nspans - 1) / nspans,
+        .nspans = nspans,
+    };
+
+    threadpool_run(parallel_pool, parallel_task, &job, nspans);
+}
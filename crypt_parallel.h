@@ -0,0 +1,16 @@
+#ifndef SALSA20_CRYPT_PARALLEL_H
+#define SALSA20_CRYPT_PARALLEL_H
+
+#include <aio.h>
+#include <stdint.h>
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+typedef void (*crypt_func)(size_t, const uint8_t[], uint8_t[], uint32_t[8], uint64_t, uint64_t, core_func);
+
+int salsa20_parallel_init(size_t nthreads, crypt_func crypt);
+
+void salsa20_parallel_destroy(void);
+
+void salsa20_crypt_parallel(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+
+#endif  // SALSA20_CRYPT_PARALLEL_H
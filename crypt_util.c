@@ -0,0 +1,45 @@
+#include <aio.h>
+#include <stdint.h>
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+
+/*  All crypt implementations can start at an arbitrary byte offset of the key
+*   stream. Byte i of the message is then encrypted with byte offset + i of the
+*   key stream, i.e. with byte (offset + i) % 64 of the block with the counter
+*   (offset + i) / 64.
+*
+*   If the offset is not a multiple of 64, this function encrypts the bytes up to
+*   the next block boundary via SISD (at most 63 bytes) and returns their number.
+*   The crypt implementations then continue with whole blocks starting at the
+*   counter (offset + returned value) / 64.
+*/
+size_t salsa20_crypt_head(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core) {
+    size_t skip = offset % 64;
+
+    if (skip == 0 || mlen == 0) {
+        return 0;
+    }
+
+    uint64_t counter = offset / 64;
+    uint32_t diag[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+
+    const uint32_t input[16] = {
+        diag[0], key[0], key[1], key[2],
+        key[3], diag[1], iv & 0xffffffff, iv >> 32,
+        counter & 0xffffffff, counter >> 32, diag[2], key[4],
+        key[5], key[6], key[7], diag[3]
+    };
+    uint32_t output[16];
+
+    core(output, input);
+
+    uint8_t* key_byte_stream = (uint8_t*) output;
+    size_t n = 0;
+
+    while (n < mlen && skip + n < 64) {
+        cipher[n] = msg[n] ^ key_byte_stream[skip + n];
+        n++;
+    }
+
+    return n;
+}
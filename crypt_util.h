@@ -0,0 +1,44 @@
+#ifndef SALSA20_CRYPT_UTIL_H
+#define SALSA20_CRYPT_UTIL_H
+
+#include <aio.h>
+#include <stdint.h>
+#include <emmintrin.h>
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+
+/*  Defines name as a crypt_func with the cores fixed at compile time: impl is the
+*   always_inline body of a crypt implementation, the remaining arguments are the
+*   cores it takes (the static inline version of a single-block core such as
+*   salsa20_core_v3_inline and, for the SIMD drivers, a multi-block core such as
+*   salsa20_core_x4_r12). Since the cores are constants, the compiler turns the
+*   calls into direct calls and inlines the single-block core, so the state can stay
+*   in registers. The core_func argument of the generated function is ignored, it only
+*   keeps the signature of crypt_func for the function table in dispatch.c. attr are
+*   the function attributes of impl (e.g. the target), which the generated function
+*   needs as well.
+*/
+#define SALSA20_CRYPT_SPECIALIZE(attr, name, impl, ...) \
+    attr void name(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func unused) { \
+        (void) unused; \
+        impl(mlen, msg, cipher, key, iv, offset, __VA_ARGS__); \
+    }
+
+size_t salsa20_crypt_head(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+
+// Xor's len <= 64 bytes of key stream into the message, whole blocks via SSE2
+static inline void salsa20_xor_block(const uint8_t* in, uint8_t* out, const uint8_t* key_byte_stream, size_t len) {
+    if (len == 64) {
+        for (size_t i = 0; i < 64; i += 16) {
+            __m128i msg_vec = _mm_loadu_si128((const __m128i_u*) (in + i));
+            __m128i key_stream_vec = _mm_loadu_si128((const __m128i_u*) (key_byte_stream + i));
+            _mm_storeu_si128((__m128i_u*) (out + i), _mm_xor_si128(msg_vec, key_stream_vec));
+        }
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            out[i] = in[i] ^ key_byte_stream[i];
+        }
+    }
+}
+
+#endif  // SALSA20_CRYPT_UTIL_H
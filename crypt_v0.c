@@ -2,17 +2,25 @@
 #include <stdint.h>
 
 #include "mtr_util.h"
+#include "core_v0.h"
+#include "core_v1.h"
+#include "core_v2.h"
+#include "core_v3.h"
+#include "crypt_util.h"
 
 typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
 
 /*
 *   This crypt implementation is a normal SISD implementation,
 *   which creates all needed uint32_t variables to set up the
-*   matrix for calling the given core method.
+*   matrix for calling the given core method. The message is encrypted
+*   with the key stream starting at byte offset (see salsa20_crypt_head).
+*   The body is instantiated once per core below, salsa20_crypt_v0 keeps
+*   the core as a function pointer.
 */
-void salsa20_crypt_v0(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, core_func core){
-    uint64_t counter = 0;
-    size_t n = 0;
+static inline __attribute__((always_inline)) void salsa20_crypt_v0_impl(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core){
+    size_t n = salsa20_crypt_head(mlen, msg, cipher, key, iv, offset, core);
+    uint64_t counter = (offset + n) / 64;
     uint32_t cons[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
     uint32_t iv32[2];
     iv32[0] = 0xffffffff & iv;
@@ -63,3 +71,22 @@ void salsa20_crypt_v0(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen]
         counter++;
     }
 }
+
+// Calls the core through the function pointer for every block, for experiments with other cores
+void salsa20_crypt_v0(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core) {
+    salsa20_crypt_v0_impl(mlen, msg, cipher, key, iv, offset, core);
+}
+
+// V0 to V3: the core is inlined into the loop (see SALSA20_CRYPT_SPECIALIZE), Salsa20/20, /12 and /8
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v0, salsa20_crypt_v0_impl, salsa20_core_v0_inline)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v1, salsa20_crypt_v0_impl, salsa20_core_v1_inline)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v2, salsa20_crypt_v0_impl, salsa20_core_v2_inline)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v3, salsa20_crypt_v0_impl, salsa20_core_v3_inline)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v0_r12, salsa20_crypt_v0_impl, salsa20_core_v0_inline_r12)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v1_r12, salsa20_crypt_v0_impl, salsa20_core_v1_inline_r12)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v2_r12, salsa20_crypt_v0_impl, salsa20_core_v2_inline_r12)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v3_r12, salsa20_crypt_v0_impl, salsa20_core_v3_inline_r12)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v0_r8, salsa20_crypt_v0_impl, salsa20_core_v0_inline_r8)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v1_r8, salsa20_crypt_v0_impl, salsa20_core_v1_inline_r8)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v2_r8, salsa20_crypt_v0_impl, salsa20_core_v2_inline_r8)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v0_core_v3_r8, salsa20_crypt_v0_impl, salsa20_core_v3_inline_r8)
@@ -2,6 +2,14 @@
 #include <stdint.h>
 #include <emmintrin.h>
 
+#include "core_v0.h"
+#include "core_v1.h"
+#include "core_v2.h"
+#include "core_v3.h"
+#include "core_x4.h"
+#include "crypt_nt.h"
+#include "crypt_util.h"
+
 typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
 
 /*  This crypt implementation uses SIMD to encrypt the message. It generates
@@ -11,10 +19,26 @@ typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
 *   variables which are then xor'ed to create the encrypted message. Whenever
 *   all 64 encrypting bytes are used up a new salsa20 block is generated after
 *   incrementing the counter which ensures a distinct block is created.
+*   If a multi-block core (wide) is given, four blocks are generated at once by the
+*   word-sliced salsa20_core_x4 as long as at least 256 bytes of the message remain,
+*   and the given core_func is only used for the last few blocks of the message and
+*   for the first partial block if the key stream starts at an offset that is not a
+*   multiple of 64 (see salsa20_crypt_head). Only V7 takes that bulk path (and the
+*   non-temporal one of crypt_nt.c, which needs the multi-block core), V4 to V6
+*   pass NULL so that every block goes through their core. Like salsa20_crypt_v0,
+*   the body is instantiated once per core below.
 */
-void salsa20_crypt_v1(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, core_func core) {
+static inline __attribute__((always_inline)) void salsa20_crypt_v1_impl(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core, core_func wide) {
+    // Bytes up to the first block boundary of the key stream
+    size_t head = salsa20_crypt_head(mlen, msg, cipher, key, iv, offset, core);
+
+    // Above the threshold the bulk of the message is written with non-temporal stores (see crypt_nt.c)
+    if (wide && mlen - head >= salsa20_nt_threshold()) {
+        head += salsa20_crypt_nt_x4(mlen - head, msg + head, cipher + head, key, iv, offset + head, wide);
+    }
+
     // Salsa20 counter variable gets initialized as a uint64 for easier incrementation
-    uint64_t counter = 0;
+    uint64_t counter = (offset + head) / 64;
 
     // Constant on the diagonal
     uint32_t diag[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
@@ -25,11 +49,39 @@ void salsa20_crypt_v1(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen]
     uint32_t iv1 = *(iv_ptr + 1);
 
     // Pointers for current position in msg and cipher text.
-    uint8_t* msg_ptr = (uint8_t*) msg;
-    uint8_t* cip_ptr = (uint8_t*) cipher;
+    uint8_t* msg_ptr = (uint8_t*) msg + head;
+    uint8_t* cip_ptr = (uint8_t*) cipher + head;
 
     // Seperate index variable to access bytes when we will encrypt the residual bytes that can not fit into _m128 variables
-    size_t cur_index = 0;
+    size_t cur_index = head;
+
+    // Bulk path: encrypt 256 bytes per iteration with four blocks of the multi-block core
+    while (wide && mlen - cur_index >= 256) {
+        uint32_t* c_ptr = (uint32_t*) &counter;
+
+        uint32_t input[16] = {
+            diag[0], key[0], key[1], key[2],
+            key[3], diag[1], iv0, iv1,
+            *c_ptr, *(c_ptr + 1), diag[2], key[4],
+            key[5], key[6], key[7], diag[3]
+        };
+
+        uint32_t output[64];
+        wide(output, input);
+
+        __m128i_u* key_stream_ptr = (__m128i_u*) output;
+        for (size_t i = 0; i < 16; i++) {
+            __m128i_u msg_vec = _mm_loadu_si128((__m128i_u*) msg_ptr);
+            __m128i_u key_stream_vec = _mm_loadu_si128(key_stream_ptr + i);
+            _mm_storeu_si128((__m128i_u*) cip_ptr, _mm_xor_si128(msg_vec, key_stream_vec));
+
+            msg_ptr += 16;
+            cip_ptr += 16;
+        }
+
+        cur_index += 256;
+        counter += 4;
+    }
 
     while (cur_index < mlen) {
         // Cast counter to uint32 to access the two fields
@@ -91,3 +143,22 @@ void salsa20_crypt_v1(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen]
         counter++;
     }
 }
+
+// Calls the core through the function pointer, for experiments with other cores
+void salsa20_crypt_v1(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core) {
+    salsa20_crypt_v1_impl(mlen, msg, cipher, key, iv, offset, core, salsa20_core_x4);
+}
+
+// V4 to V7: the core is inlined into the loop (see SALSA20_CRYPT_SPECIALIZE), Salsa20/20, /12 and /8, only V7 with the x4 bulk path
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v0, salsa20_crypt_v1_impl, salsa20_core_v0_inline, NULL)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v1, salsa20_crypt_v1_impl, salsa20_core_v1_inline, NULL)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v2, salsa20_crypt_v1_impl, salsa20_core_v2_inline, NULL)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v3, salsa20_crypt_v1_impl, salsa20_core_v3_inline, salsa20_core_x4)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v0_r12, salsa20_crypt_v1_impl, salsa20_core_v0_inline_r12, NULL)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v1_r12, salsa20_crypt_v1_impl, salsa20_core_v1_inline_r12, NULL)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v2_r12, salsa20_crypt_v1_impl, salsa20_core_v2_inline_r12, NULL)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v3_r12, salsa20_crypt_v1_impl, salsa20_core_v3_inline_r12, salsa20_core_x4_r12)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v0_r8, salsa20_crypt_v1_impl, salsa20_core_v0_inline_r8, NULL)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v1_r8, salsa20_crypt_v1_impl, salsa20_core_v1_inline_r8, NULL)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v2_r8, salsa20_crypt_v1_impl, salsa20_core_v2_inline_r8, NULL)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v1_core_v3_r8, salsa20_crypt_v1_impl, salsa20_core_v3_inline_r8, salsa20_core_x4_r8)
@@ -6,6 +6,21 @@
 
 typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
 
-void salsa20_crypt_v1(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, core_func core);
+void salsa20_crypt_v1(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
 
-#endif  // SALSA20_CRYPT_V1_H
\ No newline at end of file
+void salsa20_crypt_v1_core_v0(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+void salsa20_crypt_v1_core_v1(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+void salsa20_crypt_v1_core_v2(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+void salsa20_crypt_v1_core_v3(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+
+void salsa20_crypt_v1_core_v0_r12(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+void salsa20_crypt_v1_core_v1_r12(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+void salsa20_crypt_v1_core_v2_r12(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+void salsa20_crypt_v1_core_v3_r12(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+
+void salsa20_crypt_v1_core_v0_r8(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+void salsa20_crypt_v1_core_v1_r8(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+void salsa20_crypt_v1_core_v2_r8(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+void salsa20_crypt_v1_core_v3_r8(size_t mlen, const uint8_t msg[], uint8_t cipher[], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core);
+
+#endif  // SALSA20_CRYPT_V1_H
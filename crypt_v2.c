@@ -0,0 +1,104 @@
+#include <aio.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "core_x8.h"
+#include "core_v3.h"
+#include "crypt_nt.h"
+#include "crypt_util.h"
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+
+/*  This crypt implementation is the AVX2 counterpart of salsa20_crypt_v1. The
+*   message is encrypted in 32 byte chunks by xor'ing __m256i_u variables. As long
+*   as at least 512 bytes of the message remain, eight blocks are generated at once
+*   by salsa20_core_x8. The remaining blocks are generated with the given core_func
+*   and the last bytes that do not fill a whole chunk are encrypted via SISD.
+*
+*   The function is compiled for AVX2 only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline)) void salsa20_crypt_v2_impl(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core, core_func wide) {
+    // Bytes up to the first block boundary of the key stream (see salsa20_crypt_head)
+    size_t cur_index = salsa20_crypt_head(mlen, msg, cipher, key, iv, offset, core);
+
+    // Above the threshold the bulk of the message is written with non-temporal stores (see crypt_nt.c)
+    if (mlen - cur_index >= salsa20_nt_threshold()) {
+        cur_index += salsa20_crypt_nt_x8(mlen - cur_index, msg + cur_index, cipher + cur_index, key, iv, offset + cur_index, wide);
+    }
+    uint64_t counter = (offset + cur_index) / 64;
+
+    // Constant on the diagonal
+    uint32_t diag[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+
+    uint32_t iv0 = iv & 0xffffffff;
+    uint32_t iv1 = iv >> 32;
+
+    // Bulk path: encrypt 512 bytes per iteration with eight blocks of the multi-block core
+    while (mlen - cur_index >= 512) {
+        uint32_t input[16] = {
+            diag[0], key[0], key[1], key[2],
+            key[3], diag[1], iv0, iv1,
+            counter & 0xffffffff, counter >> 32, diag[2], key[4],
+            key[5], key[6], key[7], diag[3]
+        };
+
+        uint32_t output[128];
+        wide(output, input);
+
+        __m256i_u* key_stream_ptr = (__m256i_u*) output;
+        for (size_t i = 0; i < 16; i++) {
+            __m256i msg_vec = _mm256_loadu_si256((__m256i_u*) (msg + cur_index));
+            __m256i key_stream_vec = _mm256_loadu_si256(key_stream_ptr + i);
+            _mm256_storeu_si256((__m256i_u*) (cipher + cur_index), _mm256_xor_si256(msg_vec, key_stream_vec));
+            cur_index += 32;
+        }
+
+        counter += 8;
+    }
+
+    while (cur_index < mlen) {
+        uint32_t input[16] = {
+            diag[0], key[0], key[1], key[2],
+            key[3], diag[1], iv0, iv1,
+            counter & 0xffffffff, counter >> 32, diag[2], key[4],
+            key[5], key[6], key[7], diag[3]
+        };
+
+        uint32_t output[16];
+        core(output, input);
+
+        uint8_t* key_byte_stream = (uint8_t*) output;
+
+        // Two 32 byte chunks per block as long as they are within the bounds of the message
+        for (size_t i = 0; i < 2 && cur_index + 31 < mlen; i++) {
+            __m256i msg_vec = _mm256_loadu_si256((__m256i_u*) (msg + cur_index));
+            __m256i key_stream_vec = _mm256_loadu_si256((__m256i_u*) key_byte_stream);
+            _mm256_storeu_si256((__m256i_u*) (cipher + cur_index), _mm256_xor_si256(msg_vec, key_stream_vec));
+
+            key_byte_stream += 32;
+            cur_index += 32;
+        }
+
+        // SISD for residual bytes of the last block
+        for (size_t i = (size_t) (key_byte_stream - (uint8_t*) output); i < 64 && cur_index < mlen; i++) {
+            cipher[cur_index] = msg[cur_index] ^ *key_byte_stream;
+            key_byte_stream++;
+            cur_index++;
+        }
+
+        counter++;
+    }
+}
+
+// Calls the core through the function pointer, for experiments with other cores
+__attribute__((target("avx2")))
+void salsa20_crypt_v2(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core) {
+    salsa20_crypt_v2_impl(mlen, msg, cipher, key, iv, offset, core, salsa20_core_x8);
+}
+
+// V8: core_v3 inlined for the last blocks (see SALSA20_CRYPT_SPECIALIZE), Salsa20/20, /12 and /8
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx2"))), salsa20_crypt_v2_core_v3, salsa20_crypt_v2_impl, salsa20_core_v3_inline, salsa20_core_x8)
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx2"))), salsa20_crypt_v2_core_v3_r12, salsa20_crypt_v2_impl, salsa20_core_v3_inline_r12, salsa20_core_x8_r12)
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx2"))), salsa20_crypt_v2_core_v3_r8, salsa20_crypt_v2_impl, salsa20_core_v3_inline_r8, salsa20_core_x8_r8)
@@ -0,0 +1,100 @@
+#include <aio.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "core_x16.h"
+#include "core_v3.h"
+#include "crypt_nt.h"
+#include "crypt_util.h"
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+
+/*  This crypt implementation is the AVX-512 counterpart of salsa20_crypt_v1. A
+*   whole salsa20 block fits into one __m512i variable, so the message is encrypted
+*   in 64 byte chunks. As long as at least 1 KiB of the message remains, sixteen
+*   blocks are generated at once by salsa20_core_x16. The remaining blocks are
+*   generated with the given core_func. Instead of a SISD loop for the residual
+*   bytes, the last partial block is encrypted with masked loads and stores that
+*   only touch the bytes within the bounds of the message.
+*
+*   The function is compiled for AVX-512F/BW only, the caller has to make sure
+*   that the CPU supports it.
+*/
+__attribute__((target("avx512f,avx512bw")))
+static inline __attribute__((always_inline)) void salsa20_crypt_v3_impl(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core, core_func wide) {
+    // Bytes up to the first block boundary of the key stream (see salsa20_crypt_head)
+    size_t cur_index = salsa20_crypt_head(mlen, msg, cipher, key, iv, offset, core);
+
+    // Above the threshold the bulk of the message is written with non-temporal stores (see crypt_nt.c)
+    if (mlen - cur_index >= salsa20_nt_threshold()) {
+        cur_index += salsa20_crypt_nt_x16(mlen - cur_index, msg + cur_index, cipher + cur_index, key, iv, offset + cur_index, wide);
+    }
+    uint64_t counter = (offset + cur_index) / 64;
+
+    // Constant on the diagonal
+    uint32_t diag[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+
+    uint32_t iv0 = iv & 0xffffffff;
+    uint32_t iv1 = iv >> 32;
+
+    // Bulk path: encrypt 1 KiB per iteration with sixteen blocks of the multi-block core
+    while (mlen - cur_index >= 1024) {
+        uint32_t input[16] = {
+            diag[0], key[0], key[1], key[2],
+            key[3], diag[1], iv0, iv1,
+            counter & 0xffffffff, counter >> 32, diag[2], key[4],
+            key[5], key[6], key[7], diag[3]
+        };
+
+        uint32_t output[256];
+        wide(output, input);
+
+        for (size_t i = 0; i < 16; i++) {
+            __m512i msg_vec = _mm512_loadu_si512(msg + cur_index);
+            __m512i key_stream_vec = _mm512_loadu_si512(output + 16 * i);
+            _mm512_storeu_si512(cipher + cur_index, _mm512_xor_si512(msg_vec, key_stream_vec));
+            cur_index += 64;
+        }
+
+        counter += 16;
+    }
+
+    while (cur_index < mlen) {
+        uint32_t input[16] = {
+            diag[0], key[0], key[1], key[2],
+            key[3], diag[1], iv0, iv1,
+            counter & 0xffffffff, counter >> 32, diag[2], key[4],
+            key[5], key[6], key[7], diag[3]
+        };
+
+        uint32_t output[16];
+        core(output, input);
+
+        __m512i key_stream_vec = _mm512_loadu_si512(output);
+
+        if (mlen - cur_index >= 64) {
+            __m512i msg_vec = _mm512_loadu_si512(msg + cur_index);
+            _mm512_storeu_si512(cipher + cur_index, _mm512_xor_si512(msg_vec, key_stream_vec));
+            cur_index += 64;
+        } else {
+            // Only the bytes selected by the mask are loaded from msg and stored to cipher
+            __mmask64 mask = _cvtu64_mask64((1ULL << (mlen - cur_index)) - 1);
+            __m512i msg_vec = _mm512_maskz_loadu_epi8(mask, msg + cur_index);
+            _mm512_mask_storeu_epi8(cipher + cur_index, mask, _mm512_xor_si512(msg_vec, key_stream_vec));
+            cur_index = mlen;
+        }
+
+        counter++;
+    }
+}
+
+// Calls the core through the function pointer, for experiments with other cores
+__attribute__((target("avx512f,avx512bw")))
+void salsa20_crypt_v3(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core) {
+    salsa20_crypt_v3_impl(mlen, msg, cipher, key, iv, offset, core, salsa20_core_x16);
+}
+
+// V9: core_v3 inlined for the last blocks (see SALSA20_CRYPT_SPECIALIZE), Salsa20/20, /12 and /8
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx512f,avx512bw"))), salsa20_crypt_v3_core_v3, salsa20_crypt_v3_impl, salsa20_core_v3_inline, salsa20_core_x16)
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx512f,avx512bw"))), salsa20_crypt_v3_core_v3_r12, salsa20_crypt_v3_impl, salsa20_core_v3_inline_r12, salsa20_core_x16_r12)
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx512f,avx512bw"))), salsa20_crypt_v3_core_v3_r8, salsa20_crypt_v3_impl, salsa20_core_v3_inline_r8, salsa20_core_x16_r8)
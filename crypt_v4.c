@@ -0,0 +1,46 @@
+#include <aio.h>
+#include <stdint.h>
+
+#include "core_state.h"
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+
+/*  This crypt implementation uses the fused kernel salsa20_xor_blocks, which xors
+*   the message directly with the registers of the core instead of writing the key
+*   stream to an output[16] and loading it again. The state is set up once in the
+*   diagonal layout, so there is no per-block matrix setup either. Only the last
+*   partial blocks at the start (if the key stream starts at an offset that is
+*   not a multiple of 64) and at the end go through a key stream buffer and are
+*   encrypted via SISD. The given core_func is not used.
+*/
+void salsa20_crypt_v4(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core) {
+    (void) core;
+
+    struct salsa20_state state;
+    salsa20_state_init(&state, key, iv, offset / 64);
+
+    uint8_t key_stream[64];
+    size_t cur_index = 0;
+
+    // Bytes up to the first block boundary of the key stream
+    if (offset % 64) {
+        salsa20_core_state(key_stream, &state);
+
+        for (size_t i = offset % 64; i < 64 && cur_index < mlen; i++) {
+            cipher[cur_index] = msg[cur_index] ^ key_stream[i];
+            cur_index++;
+        }
+    }
+
+    size_t nblocks = (mlen - cur_index) / 64;
+    salsa20_xor_blocks(&state, msg + cur_index, cipher + cur_index, nblocks);
+    cur_index += nblocks * 64;
+
+    if (cur_index < mlen) {
+        salsa20_core_state(key_stream, &state);
+
+        for (size_t i = 0; cur_index + i < mlen; i++) {
+            cipher[cur_index + i] = msg[cur_index + i] ^ key_stream[i];
+        }
+    }
+}
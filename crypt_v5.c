@@ -0,0 +1,94 @@
+#include <aio.h>
+#include <stdint.h>
+#include <emmintrin.h>
+
+#include "core_v3.h"
+#include "core_x4.h"
+#include "crypt_nt.h"
+#include "crypt_util.h"
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+
+// Blocks of key stream per tile: 1 KiB, together with the message and cipher bytes well within L1
+#define TILE_BLOCKS 16
+
+// Generates nblocks (a multiple of 4) blocks of key stream starting at counter into the tile
+static inline void salsa20_tile_x4(uint32_t tile[16 * TILE_BLOCKS], uint32_t input[16], uint64_t counter, size_t nblocks, core_func wide) {
+    for (size_t b = 0; b < nblocks; b += 4) {
+        input[8] = (counter + b) & 0xffffffff;
+        input[9] = (counter + b) >> 32;
+        wide(tile + 16 * b, input);
+    }
+}
+
+/*  Tiled version of salsa20_crypt_v1. Instead of alternating between one core call
+*   and a few xor's with a bounds check, a tile of 16 blocks of key stream is
+*   generated first by salsa20_core_x4 and then xor'ed against 1 KiB of the message
+*   in one straight loop without any branches except for the loop itself. The end
+*   of the message is handled once: the last tile only has as many blocks as needed
+*   and its last bytes that do not fill 16 bytes are encrypted via SISD.
+*   The given core_func is only used for a partial first block (see salsa20_crypt_head).
+*/
+static inline __attribute__((always_inline)) void salsa20_crypt_v5_impl(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core, core_func wide) {
+    size_t cur_index = salsa20_crypt_head(mlen, msg, cipher, key, iv, offset, core);
+
+    // Above the threshold the bulk of the message is written with non-temporal stores (see crypt_nt.c)
+    if (mlen - cur_index >= salsa20_nt_threshold()) {
+        cur_index += salsa20_crypt_nt_x4(mlen - cur_index, msg + cur_index, cipher + cur_index, key, iv, offset + cur_index, wide);
+    }
+    uint64_t counter = (offset + cur_index) / 64;
+
+    uint32_t input[16] = {
+        0x61707865, key[0], key[1], key[2],
+        key[3], 0x3320646e, iv & 0xffffffff, iv >> 32,
+        0, 0, 0x79622d32, key[4],
+        key[5], key[6], key[7], 0x6b206574
+    };
+
+    uint32_t tile[16 * TILE_BLOCKS] __attribute__((aligned(64)));
+    const __m128i* key_stream_ptr = (const __m128i*) tile;
+
+    while (mlen - cur_index >= 64 * TILE_BLOCKS) {
+        salsa20_tile_x4(tile, input, counter, TILE_BLOCKS, wide);
+
+        const uint8_t* msg_ptr = msg + cur_index;
+        uint8_t* cip_ptr = cipher + cur_index;
+        for (size_t i = 0; i < 4 * TILE_BLOCKS; i++) {
+            __m128i msg_vec = _mm_loadu_si128((const __m128i_u*) msg_ptr + i);
+            _mm_storeu_si128((__m128i_u*) cip_ptr + i, _mm_xor_si128(msg_vec, key_stream_ptr[i]));
+        }
+
+        cur_index += 64 * TILE_BLOCKS;
+        counter += TILE_BLOCKS;
+    }
+
+    if (cur_index < mlen) {
+        size_t rest = mlen - cur_index;
+
+        // Whole blocks needed for the rest, rounded up to the four blocks of the core
+        salsa20_tile_x4(tile, input, counter, ((rest + 63) / 64 + 3) & ~(size_t) 3, wide);
+
+        const uint8_t* msg_ptr = msg + cur_index;
+        uint8_t* cip_ptr = cipher + cur_index;
+        size_t i = 0;
+        for (; i < rest / 16; i++) {
+            __m128i msg_vec = _mm_loadu_si128((const __m128i_u*) msg_ptr + i);
+            _mm_storeu_si128((__m128i_u*) cip_ptr + i, _mm_xor_si128(msg_vec, key_stream_ptr[i]));
+        }
+
+        const uint8_t* key_byte_stream = (const uint8_t*) tile;
+        for (i *= 16; i < rest; i++) {
+            cip_ptr[i] = msg_ptr[i] ^ key_byte_stream[i];
+        }
+    }
+}
+
+// Calls the cores through function pointers, for experiments with other cores
+void salsa20_crypt_v5(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core) {
+    salsa20_crypt_v5_impl(mlen, msg, cipher, key, iv, offset, core, salsa20_core_x4);
+}
+
+// V11: Salsa20/20, /12 and /8 (see SALSA20_CRYPT_SPECIALIZE)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v5_core_v3, salsa20_crypt_v5_impl, salsa20_core_v3_inline, salsa20_core_x4)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v5_core_v3_r12, salsa20_crypt_v5_impl, salsa20_core_v3_inline_r12, salsa20_core_x4_r12)
+SALSA20_CRYPT_SPECIALIZE(, salsa20_crypt_v5_core_v3_r8, salsa20_crypt_v5_impl, salsa20_core_v3_inline_r8, salsa20_core_x4_r8)
@@ -0,0 +1,104 @@
+#include <aio.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "core_pre.h"
+#include "core_x8.h"
+#include "core_x16.h"
+#include "core_v3.h"
+#include "crypt_nt.h"
+#include "crypt_util.h"
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+
+typedef size_t (*crypt_nt_func)(size_t, const uint8_t[], uint8_t[], const uint32_t[8], uint64_t, uint64_t, core_func);
+
+/*  salsa20_crypt_v2 with the first double round partly precomputed (see
+*   salsa20_precompute): the bulk path generates width (8 or 16) blocks per call of
+*   wide_pre, which only computes the counter dependent steps of the first double
+*   round. The precomputation is repeated whenever the high word of the counter
+*   changes. Calls whose blocks would wrap the low word go to the regular wide core,
+*   so do the non-temporal path and the head, the last blocks use core.
+*
+*   The function is compiled for AVX2 only, the caller has to make sure
+*   that the CPU supports it (and AVX-512F for the 16 block cores).
+*/
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline)) void salsa20_crypt_v7_impl(size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, core_func core, core_func wide, core_pre_func wide_pre, crypt_nt_func nt, const size_t width) {
+    // Bytes up to the first block boundary of the key stream (see salsa20_crypt_head)
+    size_t cur_index = salsa20_crypt_head(mlen, msg, cipher, key, iv, offset, core);
+
+    // Above the threshold the bulk of the message is written with non-temporal stores (see crypt_nt.c)
+    if (mlen - cur_index >= salsa20_nt_threshold()) {
+        cur_index += nt(mlen - cur_index, msg + cur_index, cipher + cur_index, key, iv, offset + cur_index, wide);
+    }
+    uint64_t counter = (offset + cur_index) / 64;
+
+    // Constant on the diagonal
+    uint32_t diag[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+
+    uint32_t iv0 = iv & 0xffffffff;
+    uint32_t iv1 = iv >> 32;
+
+    struct salsa20_precomp pre;
+    int pre_valid = 0;
+
+    // Bulk path: encrypt 64 * width bytes per iteration with the multi-block core
+    while (mlen - cur_index >= 64 * width) {
+        uint32_t input[16] = {
+            diag[0], key[0], key[1], key[2],
+            key[3], diag[1], iv0, iv1,
+            counter & 0xffffffff, counter >> 32, diag[2], key[4],
+            key[5], key[6], key[7], diag[3]
+        };
+
+        uint32_t output[256];
+        if ((counter & 0xffffffff) > UINT32_MAX - (width - 1)) {
+            wide(output, input);
+        } else {
+            if (!pre_valid || pre.input[9] != input[9]) {
+                salsa20_precompute(&pre, input);
+                pre_valid = 1;
+            }
+            wide_pre(output, &pre, counter & 0xffffffff);
+        }
+
+        __m256i_u* key_stream_ptr = (__m256i_u*) output;
+        for (size_t i = 0; i < 2 * width; i++) {
+            __m256i msg_vec = _mm256_loadu_si256((__m256i_u*) (msg + cur_index));
+            __m256i key_stream_vec = _mm256_loadu_si256(key_stream_ptr + i);
+            _mm256_storeu_si256((__m256i_u*) (cipher + cur_index), _mm256_xor_si256(msg_vec, key_stream_vec));
+            cur_index += 32;
+        }
+
+        counter += width;
+    }
+
+    while (cur_index < mlen) {
+        uint32_t input[16] = {
+            diag[0], key[0], key[1], key[2],
+            key[3], diag[1], iv0, iv1,
+            counter & 0xffffffff, counter >> 32, diag[2], key[4],
+            key[5], key[6], key[7], diag[3]
+        };
+
+        uint32_t output[16];
+        core(output, input);
+
+        size_t len = mlen - cur_index < 64 ? mlen - cur_index : 64;
+        salsa20_xor_block(msg + cur_index, cipher + cur_index, (uint8_t*) output, len);
+        cur_index += len;
+
+        counter++;
+    }
+}
+
+// V13: eight blocks per call (AVX2), Salsa20/20, /12 and /8
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx2"))), salsa20_crypt_v7_x8, salsa20_crypt_v7_impl, salsa20_core_v3_inline, salsa20_core_x8, salsa20_core_x8_pre, salsa20_crypt_nt_x8, 8)
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx2"))), salsa20_crypt_v7_x8_r12, salsa20_crypt_v7_impl, salsa20_core_v3_inline_r12, salsa20_core_x8_r12, salsa20_core_x8_pre_r12, salsa20_crypt_nt_x8, 8)
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx2"))), salsa20_crypt_v7_x8_r8, salsa20_crypt_v7_impl, salsa20_core_v3_inline_r8, salsa20_core_x8_r8, salsa20_core_x8_pre_r8, salsa20_crypt_nt_x8, 8)
+
+// V14: sixteen blocks per call (AVX-512F), Salsa20/20, /12 and /8
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx2,avx512f"))), salsa20_crypt_v7_x16, salsa20_crypt_v7_impl, salsa20_core_v3_inline, salsa20_core_x16, salsa20_core_x16_pre, salsa20_crypt_nt_x16, 16)
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx2,avx512f"))), salsa20_crypt_v7_x16_r12, salsa20_crypt_v7_impl, salsa20_core_v3_inline_r12, salsa20_core_x16_r12, salsa20_core_x16_pre_r12, salsa20_crypt_nt_x16, 16)
+SALSA20_CRYPT_SPECIALIZE(__attribute__((target("avx2,avx512f"))), salsa20_crypt_v7_x16_r8, salsa20_crypt_v7_impl, salsa20_core_v3_inline_r8, salsa20_core_x16_r8, salsa20_core_x16_pre_r8, salsa20_crypt_nt_x16, 16)
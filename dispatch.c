@@ -0,0 +1,191 @@
+#include <aio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cpuid.h>
+#include <pthread.h>
+
+#include "core_v0.h"
+#include "core_v1.h"
+#include "core_v2.h"
+#include "core_v3.h"
+
+#include "crypt_v0.h"
+#include "crypt_v1.h"
+#include "crypt_v2.h"
+#include "crypt_v3.h"
+#include "crypt_v4.h"
+#include "crypt_v5.h"
+#include "crypt_v6.h"
+#include "crypt_v7.h"
+
+#include "dispatch.h"
+
+/*  Function table of all versions that can be selected with -V, for the given
+*   suffix of the reduced round instantiations (nothing for Salsa20/20, _r12 or _r8).
+*   The index of an entry is its version number. Where the crypt implementation calls
+*   the core per block, the entry points to the instantiation with the core inlined
+*   (salsa20_crypt_vX_core_vY), the core is still given for salsa20_crypt_head.
+*   The fused V10 only exists for 20 rounds, v4 is its crypt function (or NULL).
+*/
+#define SALSA20_IMPLS(r, rounds, v4) {                                                                               \
+    { 0, salsa20_crypt_v0_core_v0##r, salsa20_core_v0##r, 0, rounds,                                                 \
+        "V0 (Crypt_v0: SISD; Core_v0: simple)", "Core_v0 (simple)" },                                                \
+    { 1, salsa20_crypt_v0_core_v1##r, salsa20_core_v1##r, CPU_FEATURE_SSE2, rounds,                                  \
+        "V1 (Crypt_v0: SISD; Core_v1: SIMD)", "Core_v1 (SIMD)" },                                                    \
+    { 2, salsa20_crypt_v0_core_v2##r, salsa20_core_v2##r, 0, rounds,                                                 \
+        "V2 (Crypt_v0: SISD; Core_v2: no transpose)", "Core_v2 (no transpose)" },                                    \
+    { 3, salsa20_crypt_v0_core_v3##r, salsa20_core_v3##r, CPU_FEATURE_SSE2, rounds,                                  \
+        "V3 (Crypt_v0: SISD; Core_v3: optimized SIMD)", "Core_v3 (optimized SIMD)" },                                \
+    { 4, salsa20_crypt_v1_core_v0##r, salsa20_core_v0##r, CPU_FEATURE_SSE2, rounds,                                  \
+        "V4 (Crypt_v1: SIMD; Core_v0: simple)", "Core_v0 (simple)" },                                                \
+    { 5, salsa20_crypt_v1_core_v1##r, salsa20_core_v1##r, CPU_FEATURE_SSE2, rounds,                                  \
+        "V5 (Crypt_v1: SIMD; Core_v1: SIMD)", "Core_v1 (SIMD)" },                                                    \
+    { 6, salsa20_crypt_v1_core_v2##r, salsa20_core_v2##r, CPU_FEATURE_SSE2, rounds,                                  \
+        "V6 (Crypt_v1: SIMD; Core_v2: no transpose)", "Core_v2 (no transpose)" },                                    \
+    { 7, salsa20_crypt_v1_core_v3##r, salsa20_core_v3##r, CPU_FEATURE_SSE2, rounds,                                  \
+        "V7 (Crypt_v1: SIMD, x4 bulk; Core_v3: optimized SIMD)", "Core_v3 (optimized SIMD)" },                       \
+    { 8, salsa20_crypt_v2_core_v3##r, salsa20_core_v3##r, CPU_FEATURE_SSE2 | CPU_FEATURE_AVX2, rounds,               \
+        "V8 (Crypt_v2: AVX2; Core_v3: optimized SIMD)", "Core_v3 (optimized SIMD)" },                                \
+    { 9, salsa20_crypt_v3_core_v3##r, salsa20_core_v3##r,                                                            \
+        CPU_FEATURE_SSE2 | CPU_FEATURE_AVX512F | CPU_FEATURE_AVX512BW, rounds,                                       \
+        "V9 (Crypt_v3: AVX-512; Core_v3: optimized SIMD)", "Core_v3 (optimized SIMD)" },                             \
+    { 10, v4, salsa20_core_v3##r, CPU_FEATURE_SSE2, rounds,                                                          \
+        "V10 (Crypt_v4: fused SIMD; Core_v3: optimized SIMD on diagonal state)", "Core_v3 (optimized SIMD)" },       \
+    { 11, salsa20_crypt_v5_core_v3##r, salsa20_core_v3##r, CPU_FEATURE_SSE2, rounds,                                 \
+        "V11 (Crypt_v5: SIMD, L1 tiles; Core_v3: optimized SIMD)", "Core_v3 (optimized SIMD)" },                     \
+    { 12, salsa20_crypt_v6_core_v3##r, salsa20_core_v3##r, CPU_FEATURE_SSE2 | CPU_FEATURE_AVX2, rounds,              \
+        "V12 (Crypt_v6: AVX2, L1 tiles; Core_v3: optimized SIMD)", "Core_v3 (optimized SIMD)" },                     \
+    { 13, salsa20_crypt_v7_x8##r, salsa20_core_v3##r, CPU_FEATURE_SSE2 | CPU_FEATURE_AVX2, rounds,                   \
+        "V13 (Crypt_v7: AVX2, precomputed first round; Core_v3: optimized SIMD)", "Core_v3 (optimized SIMD)" },      \
+    { 14, salsa20_crypt_v7_x16##r, salsa20_core_v3##r,                                                               \
+        CPU_FEATURE_SSE2 | CPU_FEATURE_AVX2 | CPU_FEATURE_AVX512F, rounds,                                           \
+        "V14 (Crypt_v7: AVX-512, precomputed first round; Core_v3: optimized SIMD)", "Core_v3 (optimized SIMD)" },   \
+}
+
+static const struct salsa20_impl salsa20_impls[] = SALSA20_IMPLS(, 20, salsa20_crypt_v4);
+static const struct salsa20_impl salsa20_impls_r12[] = SALSA20_IMPLS(_r12, 12, NULL);
+static const struct salsa20_impl salsa20_impls_r8[] = SALSA20_IMPLS(_r8, 8, NULL);
+
+#define NUM_IMPLS (sizeof(salsa20_impls) / sizeof(salsa20_impls[0]))
+
+// Versions in the order in which salsa20_dispatch tries them (fastest first)
+static const uint32_t dispatch_order[] = { 9, 13, 8, 7, 2 };
+
+// Reads the extended control register (only valid if CPUID reports OSXSAVE)
+static uint64_t xgetbv(uint32_t index) {
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return ((uint64_t) edx << 32) | eax;
+}
+
+// Supported CPU_FEATURE_* flags, detected once by cpu_features_detect
+static uint32_t features = 0;
+static pthread_once_t features_once = PTHREAD_ONCE_INIT;
+
+/*  Reads the CPUID leaves 1 and 7 and stores the supported CPU_FEATURE_* flags.
+*   AVX2 and AVX-512 are only reported if the operating system also saves the
+*   corresponding register state (checked with XGETBV).
+*/
+static void cpu_features_detect(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint64_t xcr0 = 0;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        if (edx & bit_SSE2) {
+            features |= CPU_FEATURE_SSE2;
+        }
+        if (ecx & bit_SSSE3) {
+            features |= CPU_FEATURE_SSSE3;
+        }
+        if (ecx & bit_OSXSAVE) {
+            xcr0 = xgetbv(0);
+        }
+    }
+
+    // XMM and YMM state (AVX2), additionally opmask and ZMM state (AVX-512)
+    int ymm_enabled = (xcr0 & 0x06) == 0x06;
+    int zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        if ((ebx & bit_AVX2) && ymm_enabled) {
+            features |= CPU_FEATURE_AVX2;
+        }
+        if (zmm_enabled) {
+            if (ebx & bit_AVX512F) {
+                features |= CPU_FEATURE_AVX512F;
+            }
+            if (ebx & bit_AVX512VL) {
+                features |= CPU_FEATURE_AVX512VL;
+            }
+            if (ebx & bit_AVX512BW) {
+                features |= CPU_FEATURE_AVX512BW;
+            }
+        }
+    }
+
+}
+
+/*  Returns the supported CPU_FEATURE_* flags. They are detected on the first call,
+*   with pthread_once, because the library entry points may be called first from
+*   several threads at once.
+*/
+uint32_t cpu_features(void) {
+    pthread_once(&features_once, cpu_features_detect);
+    return features;
+}
+
+// Returns the table entry of the given version or NULL if there is no such version
+const struct salsa20_impl* salsa20_get_impl(uint32_t version) {
+    return salsa20_get_impl_rounds(version, 20);
+}
+
+/*  Returns the table entry of the given version with 20, 12 or 8 rounds, or NULL
+*   if there is no such version or round count.
+*/
+const struct salsa20_impl* salsa20_get_impl_rounds(uint32_t version, uint32_t rounds) {
+    const struct salsa20_impl* impls;
+
+    switch (rounds) {
+        case 20:
+            impls = salsa20_impls;
+            break;
+        case 12:
+            impls = salsa20_impls_r12;
+            break;
+        case 8:
+            impls = salsa20_impls_r8;
+            break;
+        default:
+            return NULL;
+    }
+
+    if (version >= NUM_IMPLS || !impls[version].crypt) {
+        return NULL;
+    }
+
+    return &impls[version];
+}
+
+// Returns 1 if the CPU supports all instructions needed by the given implementation
+int salsa20_impl_supported(const struct salsa20_impl* impl) {
+    return (cpu_features() & impl->features) == impl->features;
+}
+
+/*  Picks the fastest implementation that is supported by the CPU. V2 only uses
+*   SISD and is the fallback for CPUs without SSE2.
+*/
+const struct salsa20_impl* salsa20_dispatch(void) {
+    return salsa20_dispatch_rounds(20);
+}
+
+// salsa20_dispatch for Salsa20/20, /12 or /8 (NULL for any other round count)
+const struct salsa20_impl* salsa20_dispatch_rounds(uint32_t rounds) {
+    for (size_t i = 0; i < sizeof(dispatch_order) / sizeof(dispatch_order[0]); i++) {
+        const struct salsa20_impl* impl = salsa20_get_impl_rounds(dispatch_order[i], rounds);
+        if (impl && salsa20_impl_supported(impl)) {
+            return impl;
+        }
+    }
+
+    return salsa20_get_impl_rounds(2, rounds);
+}
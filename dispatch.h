@@ -0,0 +1,45 @@
+#ifndef SALSA20_DISPATCH_H
+#define SALSA20_DISPATCH_H
+
+#include <aio.h>
+#include <stdint.h>
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+/*  crypt_func(mlen, msg, cipher, key, iv, offset, core): every crypt implementation
+*   supports in-place operation, i.e. msg == cipher. The buffers must not overlap
+*   partially.
+*/
+typedef void (*crypt_func)(size_t, const uint8_t[], uint8_t[], uint32_t[8], uint64_t, uint64_t, core_func);
+
+// CPU features that are relevant for the choice of an implementation
+#define CPU_FEATURE_SSE2        (1u << 0)
+#define CPU_FEATURE_SSSE3       (1u << 1)
+#define CPU_FEATURE_AVX2        (1u << 2)
+#define CPU_FEATURE_AVX512F     (1u << 3)
+#define CPU_FEATURE_AVX512VL    (1u << 4)
+#define CPU_FEATURE_AVX512BW    (1u << 5)
+
+// One -V version: a crypt/core pair for a round count and the CPU features it needs
+struct salsa20_impl {
+    uint32_t version;
+    crypt_func crypt;
+    core_func core;
+    uint32_t features;
+    uint32_t rounds;    // 20, 12 or 8 (Salsa20/20, Salsa20/12, Salsa20/8)
+    const char* description;
+    const char* core_description;
+};
+
+uint32_t cpu_features(void);
+
+const struct salsa20_impl* salsa20_get_impl(uint32_t version);
+
+const struct salsa20_impl* salsa20_get_impl_rounds(uint32_t version, uint32_t rounds);
+
+int salsa20_impl_supported(const struct salsa20_impl* impl);
+
+const struct salsa20_impl* salsa20_dispatch(void);
+
+const struct salsa20_impl* salsa20_dispatch_rounds(uint32_t rounds);
+
+#endif  // SALSA20_DISPATCH_H
@@ -0,0 +1,164 @@
+#include <aio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/random.h>
+
+#include "drbg.h"
+#include "stream.h"
+
+// Random bytes buffered per thread, small enough to stay in the L1 cache
+#define DRBG_BUFFER_SIZE 16384
+
+// Requests of at least this size are generated directly into the output, in pieces of DRBG_DIRECT_SIZE
+#define DRBG_DIRECT_SIZE (1 << 20)
+
+// Fresh entropy from the kernel is mixed into the key after this many bytes
+#define DRBG_RESEED_BYTES (1ull << 30)
+
+// Bytes of key stream that become the next key and nonce
+#define DRBG_KEY_SIZE 40
+
+/*  Per-thread generator state. Every refill of buf first takes the next key and
+*   nonce from the beginning of the fresh key stream and wipes them ("fast key
+*   erasure"), so bytes that were handed out can not be reconstructed from the
+*   state later on. Bytes are wiped from buf as they are handed out, too.
+*/
+struct drbg {
+    struct salsa20_ctx ctx;
+    uint8_t buf[DRBG_BUFFER_SIZE];
+    size_t pos;             // first unused byte of buf
+    uint64_t generated;     // bytes since the last reseed
+    uint64_t fork_generation;
+    int seeded;
+};
+
+static _Thread_local struct drbg drbg;
+
+// Incremented in the child after a fork, so that parent and child do not hand out the same bytes
+static volatile uint64_t fork_generation = 1;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static void drbg_child_after_fork(void) {
+    fork_generation++;
+}
+
+static void drbg_register_atfork(void) {
+    pthread_atfork(NULL, NULL, drbg_child_after_fork);
+}
+
+/*  Switches to the key and nonce in material and wipes it. The old context is wiped
+*   first: salsa20_init does not touch key_stream, which may still hold the rest of a
+*   partial block of the old key stream.
+*/
+static void drbg_rekey(struct drbg* d, uint8_t material[DRBG_KEY_SIZE]) {
+    uint32_t key[8];
+    uint64_t iv;
+
+    memcpy(key, material, 32);
+    memcpy(&iv, material + 32, 8);
+    salsa20_final(&d->ctx);
+    salsa20_init(&d->ctx, key, iv);
+
+    explicit_bzero(key, sizeof(key));
+    explicit_bzero(material, DRBG_KEY_SIZE);
+}
+
+/*  Seeds the generator from getrandom on first use, after a fork and every
+*   DRBG_RESEED_BYTES bytes. The new entropy is xor'ed into key stream of the old
+*   key, so a reseed never makes the state weaker. Returns -1 if getrandom fails.
+*/
+static int drbg_reseed(struct drbg* d) {
+    uint8_t material[DRBG_KEY_SIZE];
+    uint8_t entropy[DRBG_KEY_SIZE];
+    size_t got = 0;
+
+    pthread_once(&atfork_once, drbg_register_atfork);
+
+    while (got < DRBG_KEY_SIZE) {
+        ssize_t ret = getrandom(entropy + got, DRBG_KEY_SIZE - got, 0);
+        if (ret < 0) {
+            explicit_bzero(entropy, sizeof(entropy));
+            return -1;
+        }
+        got += ret;
+    }
+
+    if (d->seeded) {
+        salsa20_keystream(&d->ctx, material, DRBG_KEY_SIZE);
+    } else {
+        memset(material, 0, DRBG_KEY_SIZE);
+    }
+    for (size_t i = 0; i < DRBG_KEY_SIZE; i++) {
+        material[i] ^= entropy[i];
+    }
+    explicit_bzero(entropy, sizeof(entropy));
+
+    drbg_rekey(d, material);
+    d->pos = DRBG_BUFFER_SIZE;
+    d->generated = 0;
+    d->fork_generation = fork_generation;
+    d->seeded = 1;
+    return 0;
+}
+
+// Refills buf with the widest core of the CPU, its first bytes become the next key
+static void drbg_refill(struct drbg* d) {
+    salsa20_keystream(&d->ctx, d->buf, DRBG_BUFFER_SIZE);
+    drbg_rekey(d, d->buf);
+    d->pos = DRBG_KEY_SIZE;
+    d->generated += DRBG_BUFFER_SIZE;
+}
+
+/*  Fills out with len cryptographically secure random bytes from the generator of the
+*   calling thread. There is no locking: every thread has its own Salsa20 key stream
+*   and buffer, which is refilled DRBG_BUFFER_SIZE bytes at a time. Large requests are
+*   generated directly into out by salsa20_keystream, with a new key after every
+*   DRBG_DIRECT_SIZE bytes. Returns 0, or -1 if the generator could not be seeded.
+*/
+int salsa20_random(void* out, size_t len) {
+    struct drbg* d = &drbg;
+    uint8_t* dst = out;
+
+    if (!d->seeded || d->fork_generation != fork_generation || d->generated >= DRBG_RESEED_BYTES) {
+        if (drbg_reseed(d)) {
+            return -1;
+        }
+    }
+
+    while (len >= DRBG_DIRECT_SIZE) {
+        uint8_t material[DRBG_KEY_SIZE];
+
+        salsa20_keystream(&d->ctx, material, DRBG_KEY_SIZE);
+        salsa20_keystream(&d->ctx, dst, DRBG_DIRECT_SIZE);
+        drbg_rekey(d, material);
+
+        d->generated += DRBG_DIRECT_SIZE;
+        dst += DRBG_DIRECT_SIZE;
+        len -= DRBG_DIRECT_SIZE;
+
+        // A request of gigabytes still reseeds on schedule
+        if (d->generated >= DRBG_RESEED_BYTES && drbg_reseed(d)) {
+            return -1;
+        }
+    }
+
+    while (len) {
+        if (d->pos == DRBG_BUFFER_SIZE) {
+            drbg_refill(d);
+        }
+
+        size_t n = DRBG_BUFFER_SIZE - d->pos < len ? DRBG_BUFFER_SIZE - d->pos : len;
+        memcpy(dst, d->buf + d->pos, n);
+        memset(d->buf + d->pos, 0, n);
+        d->pos += n;
+        dst += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Wipes the state of the calling thread's generator, e.g. before the thread exits
+void salsa20_random_wipe(void) {
+    explicit_bzero(&drbg, sizeof(drbg));
+}
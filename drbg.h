@@ -0,0 +1,11 @@
+#ifndef SALSA20_DRBG_H
+#define SALSA20_DRBG_H
+
+#include <aio.h>
+#include <stdint.h>
+
+int salsa20_random(void* out, size_t len);
+
+void salsa20_random_wipe(void);
+
+#endif  // SALSA20_DRBG_H
@@ -1,11 +1,17 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 #include <string.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <string.h>
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+typedef void (*crypt_func)(size_t, const uint8_t[], uint8_t[], uint32_t[8], uint64_t, uint64_t, core_func);
 
 struct FileText {
     size_t len;
@@ -104,3 +110,308 @@ int write_file(const char* path, const uint8_t* string, const size_t len) {
     fclose(file);
     return suc;
 }
+
+/*  Returns 1 if out_path names the open file in_fd (same device and inode), as in
+*   "-o t" for the input t: opening the output would truncate the input before it is
+*   read. Returns 0 otherwise, also if out_path does not exist yet.
+*/
+int is_same_file(int in_fd, const char* out_path) {
+    struct stat in_stat;
+    struct stat out_stat;
+
+    if (fstat(in_fd, &in_stat) || stat(out_path, &out_stat)) {
+        return 0;
+    }
+    return in_stat.st_dev == out_stat.st_dev && in_stat.st_ino == out_stat.st_ino;
+}
+
+/*
+*   Streaming variant of read_file, crypt and write_file. The input is read in chunks
+*   of chunk_size bytes into a single buffer, which is en-/decrypted in place and
+*   written to the output file before the next chunk is read. The key stream position
+*   is carried across the chunks, so the result is the same as with the whole file in
+*   memory, while the memory usage is bounded by chunk_size.
+*
+*   Only the slice of length bytes starting at offset is processed (UINT64_MAX for
+*   everything up to the end of the file). Returns EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int crypt_file_stream(const char* in_path, const char* out_path, size_t chunk_size, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length) {
+    int suc = EXIT_SUCCESS;
+    FILE* in = NULL;
+    FILE* out = NULL;
+    uint8_t* buf = NULL;
+    uint64_t done = 0;
+    struct stat statbuf;
+
+    if (!(in = fopen(in_path, "r"))) {
+        fprintf(stderr, "Error opening file, no such file: %s\n", in_path);
+        return EXIT_FAILURE;
+    }
+
+    if (is_same_file(fileno(in), out_path)) {
+        fprintf(stderr, "The output is the input file %s, use --in-place to en-/decrypt it in place\n", in_path);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+
+    // The slice is checked before the output is created or truncated
+    if (!fstat(fileno(in), &statbuf) && S_ISREG(statbuf.st_mode)) {
+        uint64_t size = statbuf.st_size;
+        if (offset >= size || length == 0 || (length != UINT64_MAX && length > size - offset)) {
+            fprintf(stderr, "--offset/--length: the selected slice is empty or not within the %lu bytes of %s\n", size, in_path);
+            fclose(in);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (offset && fseeko(in, offset, SEEK_SET)) {
+        fprintf(stderr, "Error seeking to offset %lu in file: %s\n", offset, in_path);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+
+    if (!(buf = malloc(chunk_size))) {
+        fprintf(stderr, "Could not allocate enough memory for a chunk of %lu bytes\n", chunk_size);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+
+    if (!(out = fopen(out_path, "w"))) {
+        fprintf(stderr, "Error opening file: %s\n", out_path);
+        free(buf);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+
+    while (done < length) {
+        size_t want = length - done < chunk_size ? length - done : chunk_size;
+        size_t got = fread(buf, 1, want, in);
+
+        if (got == 0) {
+            break;
+        }
+
+        crypt(got, buf, buf, key, iv, offset + done, core);
+
+        if (fwrite(buf, 1, got, out) != got) {
+            fprintf(stderr, "Error writing to file: %s\n", out_path);
+            suc = EXIT_FAILURE;
+            break;
+        }
+
+        done += got;
+    }
+
+    if (ferror(in)) {
+        fprintf(stderr, "Error reading contents from file: %s\n", in_path);
+        suc = EXIT_FAILURE;
+    } else if (suc == EXIT_SUCCESS && (done == 0 || (length != UINT64_MAX && done < length))) {
+        fprintf(stderr, "--offset/--length: the selected slice is empty or not within the file: %s\n", in_path);
+        suc = EXIT_FAILURE;
+    }
+
+    if (fclose(out)) {
+        fprintf(stderr, "Error writing to file: %s\n", out_path);
+        suc = EXIT_FAILURE;
+    }
+
+    free(buf);
+    fclose(in);
+    return suc;
+}
+
+/*
+*   Zero-copy variant of read_file, crypt and write_file. The slice of the input file
+*   is mapped read-only and the output file is created with the size of the slice and
+*   mapped shared, so the crypt implementation reads from and writes to the page cache
+*   directly. There is no buffer in user space and no copy through stdio.
+*
+*   Only the slice of length bytes starting at offset is processed (UINT64_MAX for
+*   everything up to the end of the file). Returns EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int crypt_file_mmap(const char* in_path, const char* out_path, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length) {
+    int suc = EXIT_FAILURE;
+    int in_fd = -1;
+    int out_fd = -1;
+    uint8_t* in_map = MAP_FAILED;
+    uint8_t* out_map = MAP_FAILED;
+    struct stat statbuf;
+
+    if ((in_fd = open(in_path, O_RDONLY)) < 0) {
+        fprintf(stderr, "Error opening file, no such file: %s\n", in_path);
+        return EXIT_FAILURE;
+    }
+
+    if (fstat(in_fd, &statbuf) || !S_ISREG(statbuf.st_mode)) {
+        fprintf(stderr, "Not a regular file: %s\n", in_path);
+        close(in_fd);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t size = statbuf.st_size;
+    if (offset < size && length == UINT64_MAX) {
+        length = size - offset;
+    }
+
+    if (offset >= size || length == 0 || length > size - offset || length > SIZE_MAX) {
+        fprintf(stderr, "--offset/--length: the selected slice is empty or not within the %lu bytes of %s\n", size, in_path);
+        close(in_fd);
+        return EXIT_FAILURE;
+    }
+
+    // mmap needs an offset that is a multiple of the page size
+    uint64_t map_offset = offset & ~(uint64_t) (sysconf(_SC_PAGESIZE) - 1);
+    size_t delta = offset - map_offset;
+    size_t len = length;
+
+    if ((in_map = mmap(NULL, delta + len, PROT_READ, MAP_PRIVATE, in_fd, map_offset)) == MAP_FAILED) {
+        fprintf(stderr, "Error mapping file: %s\n", in_path);
+        goto cleanup;
+    }
+
+    // The input mapping would see the truncated output
+    if (is_same_file(in_fd, out_path)) {
+        fprintf(stderr, "The output is the input file %s, use --in-place to en-/decrypt it in place\n", in_path);
+        goto cleanup;
+    }
+
+    if ((out_fd = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        fprintf(stderr, "Error opening file: %s\n", out_path);
+        goto cleanup;
+    }
+
+    /*  Reserve the blocks up front if the file system supports it, ftruncate is enough
+    *   otherwise. A full file system has to be reported here, a write to a page of the
+    *   sparse mapping without a block behind it raises SIGBUS.
+    */
+    if (ftruncate(out_fd, len)) {
+        fprintf(stderr, "Error resizing file: %s\n", out_path);
+        goto cleanup;
+    }
+    int err = posix_fallocate(out_fd, 0, len);
+    if (err && err != EOPNOTSUPP && err != EINVAL) {
+        fprintf(stderr, "Error reserving %lu bytes for file %s: %s\n", len, out_path, strerror(err));
+        goto cleanup;
+    }
+
+    if ((out_map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, out_fd, 0)) == MAP_FAILED) {
+        fprintf(stderr, "Error mapping file: %s\n", out_path);
+        goto cleanup;
+    }
+
+    madvise(in_map, delta + len, MADV_SEQUENTIAL);
+    madvise(out_map, len, MADV_SEQUENTIAL);
+
+    crypt(len, in_map + delta, out_map, key, iv, offset, core);
+    suc = EXIT_SUCCESS;
+
+cleanup:
+    if (out_map != MAP_FAILED && munmap(out_map, len)) {
+        fprintf(stderr, "Error writing to file: %s\n", out_path);
+        suc = EXIT_FAILURE;
+    }
+    if (in_map != MAP_FAILED) {
+        munmap(in_map, delta + len);
+    }
+    if (out_fd >= 0 && close(out_fd)) {
+        fprintf(stderr, "Error writing to file: %s\n", out_path);
+        suc = EXIT_FAILURE;
+    }
+    close(in_fd);
+    return suc;
+}
+
+/*
+*   En-/decrypts the slice of length bytes starting at offset (UINT64_MAX for everything
+*   up to the end of the file) within the file itself, so neither a second file nor a
+*   second buffer is needed. With chunk_size 0 the slice is mapped shared and writable
+*   and the crypt implementation works directly on the pages of the file (msg == cipher).
+*   Otherwise the slice is processed in chunks of chunk_size bytes with pread/pwrite.
+*   Returns EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int crypt_file_inplace(const char* path, size_t chunk_size, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length) {
+    int suc = EXIT_SUCCESS;
+    int fd;
+    struct stat statbuf;
+
+    if ((fd = open(path, O_RDWR)) < 0) {
+        fprintf(stderr, "Error opening file for reading and writing: %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    if (fstat(fd, &statbuf) || !S_ISREG(statbuf.st_mode)) {
+        fprintf(stderr, "Not a regular file: %s\n", path);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t size = statbuf.st_size;
+    if (offset < size && length == UINT64_MAX) {
+        length = size - offset;
+    }
+
+    if (offset >= size || length == 0 || length > size - offset || length > SIZE_MAX) {
+        fprintf(stderr, "--offset/--length: the selected slice is empty or not within the %lu bytes of %s\n", size, path);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    if (!chunk_size) {
+        // mmap needs an offset that is a multiple of the page size
+        uint64_t map_offset = offset & ~(uint64_t) (sysconf(_SC_PAGESIZE) - 1);
+        size_t delta = offset - map_offset;
+        uint8_t* map;
+
+        if ((map = mmap(NULL, delta + length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, map_offset)) == MAP_FAILED) {
+            fprintf(stderr, "Error mapping file: %s\n", path);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+
+        madvise(map, delta + length, MADV_SEQUENTIAL);
+        crypt(length, map + delta, map + delta, key, iv, offset, core);
+
+        if (munmap(map, delta + length)) {
+            fprintf(stderr, "Error writing to file: %s\n", path);
+            suc = EXIT_FAILURE;
+        }
+    } else {
+        uint8_t* buf;
+
+        if (!(buf = malloc(chunk_size))) {
+            fprintf(stderr, "Could not allocate enough memory for a chunk of %lu bytes\n", chunk_size);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+
+        uint64_t done = 0;
+        while (done < length) {
+            size_t want = length - done < chunk_size ? length - done : chunk_size;
+            ssize_t got = pread(fd, buf, want, offset + done);
+
+            if (got <= 0) {
+                fprintf(stderr, "Error reading contents from file: %s\n", path);
+                suc = EXIT_FAILURE;
+                break;
+            }
+
+            crypt(got, buf, buf, key, iv, offset + done, core);
+
+            if (pwrite(fd, buf, got, offset + done) != got) {
+                fprintf(stderr, "Error writing to file: %s\n", path);
+                suc = EXIT_FAILURE;
+                break;
+            }
+
+            done += got;
+        }
+
+        free(buf);
+    }
+
+    if (close(fd)) {
+        fprintf(stderr, "Error writing to file: %s\n", path);
+        suc = EXIT_FAILURE;
+    }
+    return suc;
+}
@@ -1,6 +1,12 @@
 #ifndef FILE_IO_H
 #define FILE_IO_H
 
+#include <aio.h>
+#include <stdint.h>
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+typedef void (*crypt_func)(size_t, const uint8_t[], uint8_t[], uint32_t[8], uint64_t, uint64_t, core_func);
+
 struct FileText {
     size_t len;
     uint8_t* str;
@@ -10,4 +16,16 @@ struct FileText* read_file(const char* path);
 
 int write_file(const char* path, const uint8_t* string, const size_t len);
 
+int is_same_file(int in_fd, const char* out_path);
+
+int crypt_file_stream(const char* in_path, const char* out_path, size_t chunk_size, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length);
+
+int crypt_file_inplace(const char* path, size_t chunk_size, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length);
+
+int crypt_file_mmap(const char* in_path, const char* out_path, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length);
+
+int crypt_file_uring(const char* in_path, const char* out_path, size_t chunk_size, unsigned depth, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length);
+
+int crypt_file_double_buffer(const char* in_path, const char* out_path, size_t chunk_size, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length);
+
 #endif
@@ -0,0 +1,573 @@
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "fileio.h"
+
+// Default number of reads (and writes) in flight if 0 is given
+#define URING_DEFAULT_DEPTH 4
+
+/*  Minimal io_uring interface on top of the raw system calls (liburing is not a
+*   dependency of this project). The submission and completion queues are shared
+*   with the kernel through three mappings; head and tail are accessed with
+*   acquire/release semantics as described in io_uring(7).
+*/
+struct uring {
+    int fd;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    void* cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned to_submit;
+    unsigned in_flight;     // requests taken by the kernel whose completion was not reaped yet
+};
+
+// State of a buffer of the io_uring pipeline
+enum { BUF_FREE, BUF_READING, BUF_READY, BUF_WRITING };
+
+struct uring_buf {
+    uint8_t* data;
+    uint64_t pos;   // position of the chunk within the slice
+    size_t len;     // length of the chunk
+    size_t done;    // bytes of the chunk that were already read or written
+    int state;
+};
+
+static int uring_init(struct uring* ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+
+    if ((ring->fd = syscall(__NR_io_uring_setup, entries, &params)) < 0) {
+        return -1;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Older kernels need separate mappings for the submission and the completion queue
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(ring->fd);
+            return -1;
+        }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ring != ring->sq_ring) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    uint8_t* sq = ring->sq_ring;
+    uint8_t* cq = ring->cq_ring;
+    ring->sq_tail = (unsigned*) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned*) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+    return 0;
+}
+
+static void uring_exit(struct uring* ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+/*  Queues the read or write of the part of the chunk in bufs[index] that is not done
+*   yet (at most UINT32_MAX bytes). The caller never has more requests in flight than the ring has entries, so
+*   there is always a free submission queue entry.
+*/
+static void uring_prep(struct uring* ring, struct uring_buf* bufs, unsigned index, int fixed, int fd, uint64_t file_pos) {
+    struct uring_buf* buf = &bufs[index];
+    unsigned tail = *ring->sq_tail + ring->to_submit;
+    unsigned slot = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[slot];
+    int reading = buf->state == BUF_READING;
+
+    memset(sqe, 0, sizeof(*sqe));
+    if (fixed) {
+        sqe->opcode = reading ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        sqe->buf_index = index;
+    } else {
+        sqe->opcode = reading ? IORING_OP_READ : IORING_OP_WRITE;
+    }
+    sqe->fd = fd;
+    sqe->off = file_pos + buf->done;
+    sqe->addr = (uint64_t) (uintptr_t) (buf->data + buf->done);
+    // len has only 32 bits, the rest of a larger chunk is queued again like after a short read
+    sqe->len = buf->len - buf->done < UINT32_MAX ? buf->len - buf->done : UINT32_MAX;
+    sqe->user_data = index;
+
+    ring->sq_array[slot] = slot;
+    ring->to_submit++;
+}
+
+// Hands all queued requests to the kernel and waits until at least one of them has completed
+static int uring_submit_and_wait(struct uring* ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->to_submit, __ATOMIC_RELEASE);
+
+    while (1) {
+        int ret = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret >= 0) {
+            ring->to_submit -= ret;
+            ring->in_flight += ret;
+            if (!ring->to_submit) {
+                return 0;
+            }
+        } else if (errno != EINTR && errno != EAGAIN) {
+            return -1;
+        }
+    }
+}
+
+/*  Reaps completions until no request is in flight anymore. Tearing down the ring does
+*   not wait for them, so a read could still write into a buffer after it was freed.
+*   Returns -1 if waiting failed.
+*/
+static int uring_drain(struct uring* ring) {
+    while (1) {
+        unsigned head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            head++;
+            ring->in_flight--;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        if (!ring->in_flight) {
+            return 0;
+        }
+
+        if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR && errno != EAGAIN) {
+            return -1;
+        }
+    }
+}
+
+/*  Opens the input file and the output file and resolves length against the size of
+*   the input (UINT64_MAX for everything after offset). Returns EXIT_SUCCESS or
+*   EXIT_FAILURE; on success both file descriptors have to be closed by the caller.
+*/
+static int open_slice(const char* in_path, const char* out_path, uint64_t offset, uint64_t* length, int* in_fd, int* out_fd) {
+    struct stat statbuf;
+
+    if ((*in_fd = open(in_path, O_RDONLY)) < 0) {
+        fprintf(stderr, "Error opening file, no such file: %s\n", in_path);
+        return EXIT_FAILURE;
+    }
+
+    if (fstat(*in_fd, &statbuf) || !S_ISREG(statbuf.st_mode)) {
+        fprintf(stderr, "Not a regular file: %s\n", in_path);
+        close(*in_fd);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t size = statbuf.st_size;
+    if (offset < size && *length == UINT64_MAX) {
+        *length = size - offset;
+    }
+
+    if (offset >= size || *length == 0 || *length > size - offset) {
+        fprintf(stderr, "--offset/--length: the selected slice is empty or not within the %lu bytes of %s\n", size, in_path);
+        close(*in_fd);
+        return EXIT_FAILURE;
+    }
+
+    if (is_same_file(*in_fd, out_path)) {
+        fprintf(stderr, "The output is the input file %s, use --in-place to en-/decrypt it in place\n", in_path);
+        close(*in_fd);
+        return EXIT_FAILURE;
+    }
+
+    if ((*out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        fprintf(stderr, "Error opening file: %s\n", out_path);
+        close(*in_fd);
+        return EXIT_FAILURE;
+    }
+
+    // Reserve the blocks up front if the file system supports it, the writes may complete out of order
+    int err = 0;
+    if (!fstat(*out_fd, &statbuf) && S_ISREG(statbuf.st_mode)) {
+        err = posix_fallocate(*out_fd, 0, *length);
+    }
+    if (err && err != EOPNOTSUPP && err != EINVAL) {
+        fprintf(stderr, "Error reserving %lu bytes for file %s: %s\n", *length, out_path, strerror(err));
+        close(*out_fd);
+        close(*in_fd);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/*
+*   io_uring variant of crypt_file_stream. The slice is split into chunks of chunk_size
+*   bytes and 2 * depth buffers are registered with the kernel as fixed buffers. Up to
+*   depth reads and depth writes are in flight at any time; whenever a read completes,
+*   its chunk is en-/decrypted in place at its position in the key stream and queued
+*   for writing, so the order of the completions does not matter. This way the disk
+*   keeps working while the CPU generates the key stream and the run time is bound by
+*   the slower of both instead of their sum.
+*
+*   If io_uring is not available (old kernel, seccomp filter of a container, ...) the
+*   slice is processed by crypt_file_double_buffer instead. depth 0 selects a default.
+*   Returns EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int crypt_file_uring(const char* in_path, const char* out_path, size_t chunk_size, unsigned depth, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length) {
+    struct uring ring;
+
+    if (!depth) {
+        depth = URING_DEFAULT_DEPTH;
+    }
+
+    if (uring_init(&ring, 2 * depth)) {
+        return crypt_file_double_buffer(in_path, out_path, chunk_size, crypt, core, key, iv, offset, length);
+    }
+
+    int in_fd;
+    int out_fd;
+    if (open_slice(in_path, out_path, offset, &length, &in_fd, &out_fd)) {
+        uring_exit(&ring);
+        return EXIT_FAILURE;
+    }
+
+    int suc = EXIT_FAILURE;
+    unsigned nbufs = 2 * depth;
+    struct uring_buf* bufs = NULL;
+    struct iovec* iovecs = NULL;
+    int fixed = 0;
+
+    if (!(bufs = calloc(nbufs, sizeof(struct uring_buf))) || !(iovecs = calloc(nbufs, sizeof(struct iovec)))) {
+        fprintf(stderr, "Could not allocate enough memory for %u buffers\n", nbufs);
+        goto cleanup;
+    }
+
+    for (unsigned i = 0; i < nbufs; i++) {
+        if (posix_memalign((void**) &bufs[i].data, 4096, chunk_size)) {
+            fprintf(stderr, "Could not allocate enough memory for a chunk of %lu bytes\n", chunk_size);
+            goto cleanup;
+        }
+        iovecs[i].iov_base = bufs[i].data;
+        iovecs[i].iov_len = chunk_size;
+    }
+
+    // Fixed buffers save the kernel from mapping the pages for every request; fails if RLIMIT_MEMLOCK is too small
+    fixed = !syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS, iovecs, nbufs);
+
+    uint64_t next_pos = 0;  // next position within the slice that has to be read
+    uint64_t written = 0;
+    unsigned reads = 0;
+    unsigned writes = 0;
+
+    while (written < length) {
+        // Chunks that are en-/decrypted already are written as soon as there is a free write slot
+        for (unsigned i = 0; i < nbufs && writes < depth; i++) {
+            if (bufs[i].state == BUF_READY) {
+                bufs[i].state = BUF_WRITING;
+                bufs[i].done = 0;
+                uring_prep(&ring, bufs, i, fixed, out_fd, bufs[i].pos);
+                writes++;
+            }
+        }
+
+        for (unsigned i = 0; i < nbufs && reads < depth && next_pos < length; i++) {
+            if (bufs[i].state == BUF_FREE) {
+                bufs[i].state = BUF_READING;
+                bufs[i].pos = next_pos;
+                bufs[i].len = length - next_pos < chunk_size ? length - next_pos : chunk_size;
+                bufs[i].done = 0;
+                uring_prep(&ring, bufs, i, fixed, in_fd, offset + next_pos);
+                next_pos += bufs[i].len;
+                reads++;
+            }
+        }
+
+        if (uring_submit_and_wait(&ring)) {
+            fprintf(stderr, "Error submitting requests to io_uring: %s\n", strerror(errno));
+            goto cleanup;
+        }
+
+        unsigned head = *ring.cq_head;
+        while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+            struct uring_buf* buf = &bufs[cqe->user_data];
+            int res = cqe->res;
+            head++;
+            ring.in_flight--;
+
+            if (res <= 0) {
+                fprintf(stderr, "Error %s file: %s\n", buf->state == BUF_READING ? "reading contents from" : "writing to",
+                        buf->state == BUF_READING ? in_path : out_path);
+                __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+                goto cleanup;
+            }
+
+            buf->done += res;
+            if (buf->done < buf->len) {
+                // Short read or write: queue the rest of the chunk again
+                uring_prep(&ring, bufs, cqe->user_data, fixed, buf->state == BUF_READING ? in_fd : out_fd,
+                           buf->state == BUF_READING ? offset + buf->pos : buf->pos);
+            } else if (buf->state == BUF_READING) {
+                crypt(buf->len, buf->data, buf->data, key, iv, offset + buf->pos, core);
+                buf->state = BUF_READY;
+                reads--;
+            } else {
+                written += buf->len;
+                buf->state = BUF_FREE;
+                writes--;
+            }
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    suc = EXIT_SUCCESS;
+
+cleanup:
+    // After an error, requests may still be in flight and write into the buffers
+    if (uring_drain(&ring)) {
+        fprintf(stderr, "Error waiting for the requests in flight: %s\n", strerror(errno));
+        suc = EXIT_FAILURE;
+        nbufs = 0;      // the buffers are leaked rather than freed under a pending read
+    }
+    uring_exit(&ring);
+    if (bufs) {
+        for (unsigned i = 0; i < nbufs; i++) {
+            free(bufs[i].data);
+        }
+    }
+    free(iovecs);
+    free(bufs);
+    if (close(out_fd)) {
+        fprintf(stderr, "Error writing to file: %s\n", out_path);
+        suc = EXIT_FAILURE;
+    }
+    close(in_fd);
+    return suc;
+}
+
+// State of a buffer of the double buffer pipeline
+enum { DB_EMPTY, DB_FULL, DB_CRYPTED };
+
+struct double_buffer {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t* data[2];
+    size_t len[2];
+    int state[2];
+    int error;
+    int in_fd;
+    int out_fd;
+    uint64_t offset;
+    uint64_t length;
+    size_t chunk_size;
+    uint64_t nchunks;
+};
+
+static int pread_full(int fd, uint8_t* buf, size_t len, uint64_t pos) {
+    while (len) {
+        ssize_t got = pread(fd, buf, len, pos);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        } else if (got <= 0) {
+            return -1;
+        }
+        buf += got;
+        pos += got;
+        len -= got;
+    }
+    return 0;
+}
+
+static int pwrite_full(int fd, const uint8_t* buf, size_t len, uint64_t pos) {
+    while (len) {
+        ssize_t put = pwrite(fd, buf, len, pos);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        } else if (put <= 0) {
+            return -1;
+        }
+        buf += put;
+        pos += put;
+        len -= put;
+    }
+    return 0;
+}
+
+/*  I/O thread of the double buffer: for chunk k it waits until buffer k % 2 is not
+*   waiting for the crypt anymore, writes chunk k - 2 if it was en-/decrypted into that
+*   buffer and reads chunk k into it. So chunk k + 1 is read and chunk k - 1 is written
+*   while the calling thread en-/decrypts chunk k.
+*/
+static void* double_buffer_io(void* arg) {
+    struct double_buffer* db = arg;
+
+    for (uint64_t k = 0; k < db->nchunks + 2; k++) {
+        int b = k & 1;
+
+        pthread_mutex_lock(&db->lock);
+        while (db->state[b] == DB_FULL && !db->error) {
+            pthread_cond_wait(&db->cond, &db->lock);
+        }
+        int state = db->state[b];
+        int error = db->error;
+        pthread_mutex_unlock(&db->lock);
+
+        if (error) {
+            return NULL;
+        }
+
+        if (state == DB_CRYPTED && pwrite_full(db->out_fd, db->data[b], db->len[b], (k - 2) * db->chunk_size)) {
+            error = 1;
+        }
+
+        if (!error && k < db->nchunks) {
+            uint64_t pos = k * db->chunk_size;
+            db->len[b] = db->length - pos < db->chunk_size ? db->length - pos : db->chunk_size;
+            if (pread_full(db->in_fd, db->data[b], db->len[b], db->offset + pos)) {
+                error = 1;
+            }
+        }
+
+        pthread_mutex_lock(&db->lock);
+        db->state[b] = k < db->nchunks ? DB_FULL : DB_EMPTY;
+        db->error = error;
+        pthread_cond_broadcast(&db->cond);
+        pthread_mutex_unlock(&db->lock);
+
+        if (error) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/*
+*   Fallback of crypt_file_uring for systems without io_uring. A second thread does all
+*   of the reading and writing with pread/pwrite on two buffers of chunk_size bytes,
+*   while the calling thread en-/decrypts the chunk in the other buffer. Compared to
+*   crypt_file_stream only one request is in flight per direction, but the disk and
+*   the crypt still work at the same time.
+*
+*   Only the slice of length bytes starting at offset is processed (UINT64_MAX for
+*   everything up to the end of the file). Returns EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int crypt_file_double_buffer(const char* in_path, const char* out_path, size_t chunk_size, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length) {
+    struct double_buffer db;
+    pthread_t io_thread;
+    int suc = EXIT_FAILURE;
+
+    memset(&db, 0, sizeof(db));
+    if (open_slice(in_path, out_path, offset, &length, &db.in_fd, &db.out_fd)) {
+        return EXIT_FAILURE;
+    }
+
+    db.offset = offset;
+    db.length = length;
+    db.chunk_size = chunk_size;
+    db.nchunks = (length + chunk_size - 1) / chunk_size;
+
+    if (!(db.data[0] = malloc(chunk_size)) || !(db.data[1] = malloc(chunk_size))) {
+        fprintf(stderr, "Could not allocate enough memory for a chunk of %lu bytes\n", chunk_size);
+        goto cleanup;
+    }
+
+    pthread_mutex_init(&db.lock, NULL);
+    pthread_cond_init(&db.cond, NULL);
+
+    if (pthread_create(&io_thread, NULL, double_buffer_io, &db)) {
+        fprintf(stderr, "Could not create the I/O thread\n");
+        pthread_cond_destroy(&db.cond);
+        pthread_mutex_destroy(&db.lock);
+        goto cleanup;
+    }
+
+    for (uint64_t k = 0; k < db.nchunks; k++) {
+        int b = k & 1;
+
+        pthread_mutex_lock(&db.lock);
+        while (db.state[b] != DB_FULL && !db.error) {
+            pthread_cond_wait(&db.cond, &db.lock);
+        }
+        int error = db.error;
+        pthread_mutex_unlock(&db.lock);
+
+        if (error) {
+            break;
+        }
+
+        crypt(db.len[b], db.data[b], db.data[b], key, iv, offset + k * chunk_size, core);
+
+        pthread_mutex_lock(&db.lock);
+        db.state[b] = DB_CRYPTED;
+        pthread_cond_broadcast(&db.cond);
+        pthread_mutex_unlock(&db.lock);
+    }
+
+    pthread_join(io_thread, NULL);
+    pthread_cond_destroy(&db.cond);
+    pthread_mutex_destroy(&db.lock);
+
+    if (db.error) {
+        fprintf(stderr, "Error reading from %s or writing to %s\n", in_path, out_path);
+    } else {
+        suc = EXIT_SUCCESS;
+    }
+
+cleanup:
+    free(db.data[0]);
+    free(db.data[1]);
+    if (close(db.out_fd)) {
+        fprintf(stderr, "Error writing to file: %s\n", out_path);
+        suc = EXIT_FAILURE;
+    }
+    close(db.in_fd);
+    return suc;
+}
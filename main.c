@@ -5,21 +5,21 @@
 #include <getopt.h>
 #include <errno.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
-#include "core_v0.h"
-#include "core_v1.h"
-#include "core_v2.h"
-#include "core_v3.h"
-
-#include "crypt_v0.h"
-#include "crypt_v1.h"
-
+#include "crypt_nt.h"
+#include "crypt_parallel.h"
+#include "dispatch.h"
+#include "drbg.h"
 #include "fileio.h"
 #include "performance.h"
+#include "pipeline.h"
+#include "secretbox.h"
 #include "verify.h"
 
 const char* usage_msg =
-    "Usage: %s [options] f  Encrypts text in f and writes it to output file\n"
+    "Usage: %s [options] f  Encrypts text in f (- for stdin) and writes it to output file\n"
     "   or: %s -h           Show help message and exit\n"
     "   or: %s --help       Show help message and exit\n";
 
@@ -28,12 +28,40 @@ const char* help_msg =
     "   f   The file that contains the raw text that has to be en-/decrypted.\n"
     "\n"
     "Optional arguments:\n"
-    "   -V N      The version of the salsa20 crypting algorithm (default: V7 (simd crypt with optimized simd core))\n"
+    "   -V N      The version of the salsa20 crypting algorithm (default: auto (fastest version supported by the CPU),\n"
+    "             V4-V6: simd crypt with core_v0-v2 for every block,\n"
+    "             V7: simd crypt with 4-block word-sliced bulk and optimized simd core, V8 needs AVX2, V9 AVX-512,\n"
+    "             V10: fused simd crypt,\n"
+    "             V11/V12: simd/AVX2 crypt on L1 sized key stream tiles,\n"
+    "             V13/V14: AVX2/AVX-512 crypt with the first round precomputed per key and iv)\n"
     "   -B N      If set run performance test (N iterations) for the salsa20_crypt implementation (includes _core)\n"
     "   -k N      The secret key for the crypting algorithm (default: 0)\n"
     "   -i N      The initialised vector (default: 0)\n"
-    "   -o F      The file that the encrypted message will be stored to (default: \"crypt.txt\")\n"
+    "   -o F      The file that the encrypted message will be stored to (default: \"crypt.txt\", - for stdout)\n"
+    "   -j N      Number of threads that en-/decrypt the message in parallel (default: 1)\n"
+    "             Pipes and other non-regular files are processed by a reader, N encryptor and a writer thread\n"
     "   -c        If -B was also set run performance test exclusively for the salsa20_core implementation\n"
+    "   --chunk N   Stream the file in chunks of N bytes (e.g. 1048576) instead of reading it completely into memory\n"
+    "   --mmap      Map the input and output files into memory instead of reading and writing them\n"
+    "   --in-place  En-/decrypt the file itself instead of writing to -o (mapped, or with --chunk N in chunks)\n"
+    "   --batch MIN:MAX[:N]  Benchmark N (default: 1000) records of MIN to MAX bytes with their own nonce,\n"
+    "             one crypt per record against salsa20_crypt_batch (-B iterations, default: 100, f is not needed)\n"
+    "   --nt N      Write messages of at least N bytes with non-temporal stores (default: auto (size of the\n"
+    "             last level cache), off: never)\n"
+    "   --random N  Write N random bytes from the Salsa20 DRBG to -o (with -B: measure the throughput, f is not needed)\n"
+    "   --uring N   Keep N reads and N writes of --chunk bytes (default: 1048576) in flight with io_uring\n"
+    "   --rounds N  Number of rounds: 20 (default), 12 or 8 (Salsa20/12 and Salsa20/8 are not for adversarial\n"
+    "             use, V10, --batch and --random only support 20 rounds)\n"
+    "   --scrypt N:r:p  Benchmark the scrypt key derivation with cost N, block size r and p lanes (-B iterations,\n"
+    "             default: 10, f is not needed), common: the settings 16384:8:1, 16384:8:4, 1024:8:16 and 32768:8:1.\n"
+    "             The lanes run on one thread each unless -j is given\n"
+    "   --xsalsa N  Benchmark XSalsa20 on messages of N bytes with a shared nonce prefix, cached subkey against\n"
+    "             one HSalsa20 per message (-B iterations, default: 1000000, f is not needed)\n"
+    "   --seal      Encrypt and authenticate f with XSalsa20-Poly1305 (secretbox) under -k and a random nonce,\n"
+    "             -o receives nonce (24 bytes), tag (16 bytes) and cipher text (with -B: measure the throughput)\n"
+    "   --open      Check and decrypt a file written by --seal, nothing is written if the tag does not match\n"
+    "   --offset N  Only process the input starting at byte N, en-/decrypted with the key stream from byte N on (default: 0)\n"
+    "   --length N  Only process N bytes of the input (default: everything after --offset)\n"
     "   -h        Show help message (this text) and exit\n"
     "   --help    Show help message (this text) and exit\n"
     "   --verify  Run functional tests for all core and crypt implemenetations\n";
@@ -47,64 +75,6 @@ void print_help(const char* progname) {
     fprintf(stderr, "\n%s", help_msg);
 }
 
-typedef void(* core_func)(uint32_t[16], const uint32_t[16]);
-typedef void(* crypt_func)(size_t, const uint8_t[], uint8_t[], uint32_t[8], uint64_t, core_func);
-
-crypt_func getCryptImpl(uint32_t version) {
-    switch (version) {
-        case 0:
-        case 1:
-        case 2:
-        case 3:
-            return salsa20_crypt_v0;
-        case 4:
-        case 5:
-        case 6:
-        case 7:
-            return salsa20_crypt_v1;
-        default:
-            return NULL;
-    }
-}
-
-core_func getCoreImpl(uint32_t version) {
-    switch (version) {
-        case 0:
-        case 4:
-            return salsa20_core_v0;
-        case 1:
-        case 5:
-            return salsa20_core_v1;
-        case 2:
-        case 6:
-            return salsa20_core_v2;
-        case 3:
-        case 7:
-            return salsa20_core_v3;
-        default:
-            return NULL;
-    }
-}
-
-const char* version_descriptions[] = {
-    "V0 (Crypt_v0: SISD; Core_v0: simple)",
-    "V1 (Crypt_v0: SISD; Core_v1: SIMD)",
-    "V2 (Crypt_v0: SISD; Core_v2: no transpose)",
-    "V3 (Crypt_v0: SISD; Core_v3: optimized SIMD)",
-    "V4 (Crypt_v1: SIMD; Core_v0: simple)",
-    "V5 (Crypt_v1: SIMD; Core_v1: SIMD)",
-    "V6 (Crypt_v1: SIMD; Core_v2: no transpose)",
-    "V7 (Crypt_v1: SIMD; Core_v3: optimized SIMD)",
-};
-
-const char* getVersionDescription(uint32_t version) {
-    if (version > 7) {
-        return NULL;
-    }
-
-    return version_descriptions[version];
-}
-
 /*
 *   clear256, muladd256 and parse256 are helper methods for the key option parsing.
 *   clear256 is simply used to set every value in the key array to 0. muladd256 sets
@@ -213,6 +183,148 @@ char* parse256(uint32_t quad[8], char *from) {
     return NULL;
 }
 
+/*
+*   Writes len bytes from the DRBG to out_path ("-" for stdout) in pieces of 1 MiB. With
+*   iter > 0 the bytes are only generated iter times and the throughput is printed.
+*/
+int write_random(uint64_t len, uint64_t iter, const char* out_path) {
+    size_t buf_size = len < (1 << 20) ? len : (1 << 20);
+    uint8_t* buf = malloc(buf_size);
+    int suc = EXIT_SUCCESS;
+
+    if (!buf) {
+        fprintf(stderr, "Could not allocate enough memory for random bytes\n");
+        return EXIT_FAILURE;
+    }
+
+    if (iter) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint64_t i = 0; i < iter && suc == EXIT_SUCCESS; i++) {
+            for (uint64_t done = 0; done < len; done += buf_size) {
+                if (salsa20_random(buf, len - done < buf_size ? len - done : buf_size)) {
+                    fprintf(stderr, "Could not seed the random generator\n");
+                    suc = EXIT_FAILURE;
+                    break;
+                }
+            }
+        }
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+        printf("DRBG took %f seconds to generate %lu bytes %lu times (%.2f GB/s).\n", time, len, iter, iter * len / time / 1e9);
+    } else {
+        int out_fd = strcmp(out_path, "-") ? open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO;
+        if (out_fd < 0) {
+            fprintf(stderr, "Error opening file: %s\n", out_path);
+            free(buf);
+            return EXIT_FAILURE;
+        }
+
+        for (uint64_t done = 0; done < len && suc == EXIT_SUCCESS; ) {
+            size_t n = len - done < buf_size ? len - done : buf_size;
+            if (salsa20_random(buf, n)) {
+                fprintf(stderr, "Could not seed the random generator\n");
+                suc = EXIT_FAILURE;
+                break;
+            }
+            for (size_t put = 0; put < n; ) {
+                ssize_t ret = write(out_fd, buf + put, n - put);
+                if (ret < 0 && errno == EINTR) {
+                    continue;
+                } else if (ret <= 0) {
+                    fprintf(stderr, "Error writing to file: %s\n", out_path);
+                    suc = EXIT_FAILURE;
+                    break;
+                }
+                put += ret;
+            }
+            done += n;
+        }
+
+        if (out_fd != STDOUT_FILENO && close(out_fd)) {
+            fprintf(stderr, "Error writing to file: %s\n", out_path);
+            suc = EXIT_FAILURE;
+        }
+    }
+
+    explicit_bzero(buf, buf_size);
+    free(buf);
+    return suc;
+}
+
+/*
+*   Seals the content of in_path with secretbox_seal under key and a nonce from the DRBG
+*   and writes nonce, tag and cipher text to out_path. With iter > 0 nothing is written,
+*   the throughput of the single pass is compared with a separate Poly1305 pass instead.
+*/
+int seal_file(const char* in_path, const char* out_path, uint32_t key[8], uint64_t iter) {
+    struct FileText* filetext;
+    uint8_t* sealed;
+
+    if (!(filetext = read_file(in_path))) {
+        return EXIT_FAILURE;
+    }
+
+    size_t header = SECRETBOX_NONCE_SIZE + SECRETBOX_TAG_SIZE;
+    if (!(sealed = malloc(header + filetext->len))) {
+        fprintf(stderr, "Could not allocate enough memory for cipher text\n");
+        free(filetext->str);
+        free(filetext);
+        return EXIT_FAILURE;
+    }
+
+    int suc = EXIT_SUCCESS;
+    if (iter) {
+        performance_secretbox(iter, filetext->len, filetext->str, sealed + header, key);
+    } else if (salsa20_random(sealed, SECRETBOX_NONCE_SIZE)) {
+        fprintf(stderr, "Could not seed the random generator\n");
+        suc = EXIT_FAILURE;
+    } else {
+        secretbox_seal(sealed + SECRETBOX_NONCE_SIZE, sealed + header, filetext->str, filetext->len, sealed, key);
+        if (write_file(out_path, sealed, header + filetext->len)) {
+            suc = EXIT_FAILURE;
+        }
+    }
+
+    free(sealed);
+    free(filetext->str);
+    free(filetext);
+    return suc;
+}
+
+/*
+*   Opens a file written by seal_file and writes the message to out_path. If the file
+*   was modified or the key is wrong, out_path is not touched.
+*/
+int open_file(const char* in_path, const char* out_path, uint32_t key[8]) {
+    struct FileText* filetext;
+    size_t header = SECRETBOX_NONCE_SIZE + SECRETBOX_TAG_SIZE;
+
+    if (!(filetext = read_file(in_path))) {
+        return EXIT_FAILURE;
+    }
+
+    int suc = EXIT_SUCCESS;
+    uint8_t* sealed = filetext->str;
+    size_t len = filetext->len > header ? filetext->len - header : 0;
+
+    if (!len) {
+        fprintf(stderr, "%s is too short for nonce, tag and cipher text\n", in_path);
+        suc = EXIT_FAILURE;
+    } else if (secretbox_open(sealed + header, sealed + header, len, sealed + SECRETBOX_NONCE_SIZE, sealed, key)) {
+        fprintf(stderr, "%s: the tag does not match, the file was modified or the key is wrong\n", in_path);
+        suc = EXIT_FAILURE;
+    } else if (write_file(out_path, sealed + header, len)) {
+        suc = EXIT_FAILURE;
+    }
+
+    free(filetext->str);
+    free(filetext);
+    return suc;
+}
+
 /*  The main is responsible for parsing the options and running the program
  *   according to the chosen implementation and input.
  */
@@ -221,12 +333,32 @@ int main(int argc, char** argv) {
     uint32_t key[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 
     uint64_t iter = 0;      // number of iterations for performance test
+    uint64_t nthreads = 1;  // number of threads for salsa20_crypt_parallel
+    uint8_t has_nthreads = 0;   // scrypt runs one thread per lane if -j was not set
     uint8_t run_perf = 0;   // performance test flag
     uint8_t run_core = 0;   // core exclusive performance test flag 
     int failed = 0;
 
     uint64_t iv = 0;        // default nonce
-    uint32_t version = 7;   // default version 7 (Crypt_v1: SIMD; Core_v3: optimized SIMD)
+    uint64_t offset = 0;    // first byte of the input (and key stream) that is processed
+    uint64_t length = 0;
+    uint8_t has_length = 0; // process everything after offset if --length was not set
+    uint64_t chunk_size = 0; // chunk size of the streaming file mode (0: read the whole file)
+    uint8_t use_mmap = 0;   // zero-copy file mode
+    uint8_t in_place = 0;   // overwrite the input file instead of writing to out_path
+    uint64_t uring_depth = 0;   // asynchronous file mode with io_uring (0: off)
+    uint64_t batch_min = 0;     // record sizes of the batch benchmark (batch_max 0: off)
+    uint64_t batch_max = 0;
+    uint64_t batch_count = 1000;
+    uint64_t random_len = 0;    // number of random bytes to generate (0: off)
+    uint32_t version = 0;
+    uint32_t rounds = 20;       // Salsa20/20, /12 or /8
+    uint8_t seal = 0;           // secretbox mode: 1 seal, 2 open
+    uint64_t xsalsa_len = 0;    // message size of the XSalsa20 benchmark (0: off)
+    uint64_t scrypt_N = 0;      // scrypt benchmark settings (scrypt_N 0: off, UINT64_MAX: common settings)
+    uint32_t scrypt_r = 0;
+    uint32_t scrypt_p = 0;
+    uint8_t auto_version = 1;   // default: choose the fastest version supported by the CPU
     char* in_path = NULL;
     char* out_path = "crypt.txt";   // default path for output file
 
@@ -242,11 +374,25 @@ int main(int argc, char** argv) {
         static struct option long_options[] = {
             {"help", no_argument, 0, 'h'},
             {"verify", no_argument, 0, 'v'},
+            {"offset", required_argument, 0, 'O'},
+            {"length", required_argument, 0, 'L'},
+            {"chunk", required_argument, 0, 'C'},
+            {"mmap", no_argument, 0, 'M'},
+            {"in-place", no_argument, 0, 'I'},
+            {"uring", required_argument, 0, 'U'},
+            {"batch", required_argument, 0, 'R'},
+            {"random", required_argument, 0, 'D'},
+            {"nt", required_argument, 0, 'N'},
+            {"rounds", required_argument, 0, 'W'},
+            {"scrypt", required_argument, 0, 'S'},
+            {"xsalsa", required_argument, 0, 'X'},
+            {"seal", no_argument, 0, 'E'},
+            {"open", no_argument, 0, 'P'},
  	        { NULL, 0, NULL, 0}
         };
 
         int option_index = 0;
-        opt = getopt_long (argc, argv, "V:B:k:i:o:hcv", long_options, &option_index);
+        opt = getopt_long (argc, argv, "V:B:k:i:o:j:hcv", long_options, &option_index);
 
         // Break out of option parsing when getopt_long returns -1 which indicates that the end of the arguments in argv was reached.
         if (opt == -1)
@@ -254,7 +400,14 @@ int main(int argc, char** argv) {
 
         switch (opt) {
             case 'V':
+                // 'auto' lets the dispatcher choose the version at runtime.
+                if (!strcmp(optarg, "auto")) {
+                    auto_version = 1;
+                    break;
+                }
+
                 // Tries to convert the <int> argument of -V to a unsigned long. Exit on failure.
+                auto_version = 0;
                 errno = 0;
                 endptr = NULL;
                 version = strtoul(optarg, &endptr, 0);
@@ -315,6 +468,201 @@ int main(int argc, char** argv) {
                     return EXIT_FAILURE;
                 }
                 break;
+            case 'O':
+                // Tries to convert the <int> argument of --offset into a unsinged long long. Exit on failure.
+                errno = 0;
+                endptr = NULL;
+                offset = strtoull(optarg, &endptr, 0);
+
+                if (endptr == optarg || *endptr != '\0') {
+                    fprintf(stderr, "--offset: %s could not be converted to a uint64_t\n", optarg);
+                    return EXIT_FAILURE;
+                } else if (errno == ERANGE) {
+                    fprintf(stderr, "--offset: %s over- or underflows uint64_t\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'L':
+                // Tries to convert the <int> argument of --length into a unsinged long long. Exit on failure.
+                errno = 0;
+                endptr = NULL;
+                length = strtoull(optarg, &endptr, 0);
+                has_length = 1;
+
+                if (endptr == optarg || *endptr != '\0') {
+                    fprintf(stderr, "--length: %s could not be converted to a uint64_t\n", optarg);
+                    return EXIT_FAILURE;
+                } else if (errno == ERANGE) {
+                    fprintf(stderr, "--length: %s over- or underflows uint64_t\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'j':
+                // Tries to convert the <int> argument of -j to a unsigned long. Exit on failure.
+                errno = 0;
+                endptr = NULL;
+                nthreads = strtoul(optarg, &endptr, 0);
+
+                if (endptr == optarg || *endptr != '\0' || nthreads == 0) {
+                    fprintf(stderr, "-j: %s is not a positive number of threads\n", optarg);
+                    return EXIT_FAILURE;
+                } else if (errno == ERANGE) {
+                    fprintf(stderr, "-j: %s over- or underflows uint64_t\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                has_nthreads = 1;
+                break;
+            case 'C':
+                // Tries to convert the <int> argument of --chunk into a unsinged long long. Exit on failure.
+                errno = 0;
+                endptr = NULL;
+                chunk_size = strtoull(optarg, &endptr, 0);
+
+                if (endptr == optarg || *endptr != '\0' || chunk_size == 0) {
+                    fprintf(stderr, "--chunk: %s is not a positive number of bytes\n", optarg);
+                    return EXIT_FAILURE;
+                } else if (errno == ERANGE || chunk_size > SIZE_MAX) {
+                    fprintf(stderr, "--chunk: %s over- or underflows size_t\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'U':
+                // Tries to convert the <int> argument of --uring to a unsigned long. Exit on failure.
+                errno = 0;
+                endptr = NULL;
+                uring_depth = strtoul(optarg, &endptr, 0);
+
+                if (endptr == optarg || *endptr != '\0' || uring_depth == 0) {
+                    fprintf(stderr, "--uring: %s is not a positive number of requests\n", optarg);
+                    return EXIT_FAILURE;
+                } else if (errno == ERANGE || uring_depth > 4096) {
+                    fprintf(stderr, "--uring: %s exceeds the maximum of 4096 requests\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'R':
+                // Tries to convert the MIN:MAX[:N] argument of --batch into unsigned long longs. Exit on failure.
+                errno = 0;
+                batch_min = strtoull(optarg, &endptr, 0);
+                if (*endptr == ':') {
+                    char* max_str = endptr + 1;
+                    batch_max = strtoull(max_str, &endptr, 0);
+                    if (endptr == max_str) {
+                        batch_max = 0;
+                    }
+                }
+                if (*endptr == ':') {
+                    char* count_str = endptr + 1;
+                    batch_count = strtoull(count_str, &endptr, 0);
+                    if (endptr == count_str) {
+                        batch_count = 0;
+                    }
+                }
+
+                if (*endptr != '\0' || errno == ERANGE || batch_max == 0 || batch_min > batch_max || batch_count == 0) {
+                    fprintf(stderr, "--batch: %s is not of the form MIN:MAX[:N] with 0 <= MIN <= MAX, 0 < MAX and 0 < N\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'D':
+                // Tries to convert the <int> argument of --random into a unsinged long long. Exit on failure.
+                errno = 0;
+                endptr = NULL;
+                random_len = strtoull(optarg, &endptr, 0);
+
+                if (endptr == optarg || *endptr != '\0' || random_len == 0) {
+                    fprintf(stderr, "--random: %s is not a positive number of bytes\n", optarg);
+                    return EXIT_FAILURE;
+                } else if (errno == ERANGE) {
+                    fprintf(stderr, "--random: %s over- or underflows uint64_t\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'N':
+                // 'off' and 'auto' or the threshold in bytes for the non-temporal stores. Exit on failure.
+                if (!strcmp(optarg, "off")) {
+                    salsa20_set_nt_threshold(SIZE_MAX);
+                    break;
+                } else if (!strcmp(optarg, "auto")) {
+                    salsa20_set_nt_threshold(0);
+                    break;
+                }
+
+                errno = 0;
+                endptr = NULL;
+                uint64_t threshold = strtoull(optarg, &endptr, 0);
+
+                if (endptr == optarg || *endptr != '\0' || threshold == 0) {
+                    fprintf(stderr, "--nt: %s is not a positive number of bytes, off or auto\n", optarg);
+                    return EXIT_FAILURE;
+                } else if (errno == ERANGE || threshold > SIZE_MAX) {
+                    fprintf(stderr, "--nt: %s over- or underflows size_t\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                salsa20_set_nt_threshold(threshold);
+                break;
+            case 'W':
+                // Tries to convert the <int> argument of --rounds to one of the supported round counts. Exit on failure.
+                errno = 0;
+                endptr = NULL;
+                rounds = strtoul(optarg, &endptr, 0);
+
+                if (endptr == optarg || *endptr != '\0' || (rounds != 20 && rounds != 12 && rounds != 8)) {
+                    fprintf(stderr, "--rounds: %s is not one of 20, 12 or 8\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'E':
+                seal = 1;
+                break;
+            case 'P':
+                seal = 2;
+                break;
+            case 'X':
+                // Tries to convert the <int> argument of --xsalsa into a unsinged long long. Exit on failure.
+                errno = 0;
+                endptr = NULL;
+                xsalsa_len = strtoull(optarg, &endptr, 0);
+
+                if (endptr == optarg || *endptr != '\0' || xsalsa_len == 0) {
+                    fprintf(stderr, "--xsalsa: %s is not a positive number of bytes\n", optarg);
+                    return EXIT_FAILURE;
+                } else if (errno == ERANGE || xsalsa_len > (1 << 30)) {
+                    fprintf(stderr, "--xsalsa: %s exceeds the maximum of 1 GiB\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'S':
+                // 'common' or the N:r:p argument of --scrypt converted into unsigned longs. Exit on failure.
+                if (!strcmp(optarg, "common")) {
+                    scrypt_N = UINT64_MAX;
+                    break;
+                }
+
+                errno = 0;
+                scrypt_N = strtoull(optarg, &endptr, 0);
+                if (*endptr == ':') {
+                    char* r_str = endptr + 1;
+                    uint64_t r = strtoull(r_str, &endptr, 0);
+                    scrypt_r = endptr == r_str || r > UINT32_MAX ? 0 : r;
+                }
+                if (*endptr == ':') {
+                    char* p_str = endptr + 1;
+                    uint64_t p = strtoull(p_str, &endptr, 0);
+                    scrypt_p = endptr == p_str || p > UINT32_MAX ? 0 : p;
+                }
+
+                if (*endptr != '\0' || errno == ERANGE || scrypt_N < 2 || scrypt_N > UINT32_MAX || (scrypt_N & (scrypt_N - 1)) || !scrypt_r || !scrypt_p) {
+                    fprintf(stderr, "--scrypt: %s is not common or of the form N:r:p with a power of two 1 < N < 2^32, 0 < r and 0 < p\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'M':
+                use_mmap = 1;
+                break;
+            case 'I':
+                in_place = 1;
+                break;
             case 'o':
                 // Sets the path for the output file to the argument of -o.
                 out_path = optarg;
@@ -330,6 +678,30 @@ int main(int argc, char** argv) {
                 if (verify_crypt()) {
                     failed++;
                 }
+
+                if (verify_stream()) {
+                    failed++;
+                }
+
+                if (verify_batch()) {
+                    failed++;
+                }
+
+                if (verify_rounds()) {
+                    failed++;
+                }
+
+                if (verify_scrypt()) {
+                    failed++;
+                }
+
+                if (verify_xsalsa20()) {
+                    failed++;
+                }
+
+                if (verify_secretbox()) {
+                    failed++;
+                }
                     
                 if (!failed) {
                     printf("All functional tests passed!\n");
@@ -350,24 +722,211 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (optind == argc) {
+    // The DRBG and the batch API only exist for the full 20 rounds
+    if (rounds != 20 && (random_len || batch_max)) {
+        fprintf(stderr, "--random and --batch only support 20 rounds\n");
+        return EXIT_FAILURE;
+    }
+
+    if (random_len) {
+        return write_random(random_len, run_perf ? iter : 0, out_path);
+    }
+
+    // XSalsa20 is defined for 20 rounds only
+    if (seal) {
+        if (rounds != 20) {
+            fprintf(stderr, "--seal and --open only support 20 rounds\n");
+            return EXIT_FAILURE;
+        } else if (optind == argc) {
+            printf("%s: Missing positional argument -- 'f'\n", progname);
+            print_usage(progname);
+            return EXIT_FAILURE;
+        }
+        return seal == 1 ? seal_file(argv[optind], out_path, key, run_perf ? iter : 0) : open_file(argv[optind], out_path, key);
+    }
+
+    if (xsalsa_len) {
+        if (rounds != 20) {
+            fprintf(stderr, "--xsalsa only supports 20 rounds\n");
+            return EXIT_FAILURE;
+        }
+
+        uint8_t* msg = calloc(xsalsa_len, 1);
+        if (!msg) {
+            fprintf(stderr, "Could not allocate enough memory for a message of %lu bytes\n", xsalsa_len);
+            return EXIT_FAILURE;
+        }
+        performance_xsalsa20(run_perf ? iter : 1000000, xsalsa_len, msg, key);
+        free(msg);
+        return EXIT_SUCCESS;
+    }
+
+    // scrypt always uses Salsa20/8, --rounds does not apply to it
+    if (scrypt_N) {
+        const uint32_t common[][3] = { { 16384, 8, 1 }, { 16384, 8, 4 }, { 1024, 8, 16 }, { 32768, 8, 1 } };
+        size_t n = scrypt_N == UINT64_MAX ? sizeof(common) / sizeof(common[0]) : 1;
+
+        for (size_t i = 0; i < n; i++) {
+            if (scrypt_N == UINT64_MAX) {
+                scrypt_r = common[i][1];
+                scrypt_p = common[i][2];
+            }
+            if (performance_scrypt(run_perf ? iter : 10, scrypt_N == UINT64_MAX ? common[i][0] : scrypt_N, scrypt_r, scrypt_p, has_nthreads ? nthreads : 0)) {
+                return EXIT_FAILURE;
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (optind == argc && !batch_max) {
         printf("%s: Missing positional argument -- 'f'\n", progname);
         print_usage(progname);
         return EXIT_FAILURE;
     }
 
-    // Set the path of the input file to the positional argument in argv.
+    // Set the path of the input file to the positional argument in argv (NULL for the batch benchmark).
     in_path = argv[optind];
 
     // Depending on the parsed version choose the correct implementation for salsa20_core and salsa20_crypt.
-    if (version > 7) {
-        fprintf(stderr, "There is no implementation V%u for the salsa20/20 algorithm.\n", version);
+    const struct salsa20_impl* impl;
+
+    if (auto_version) {
+        impl = salsa20_dispatch_rounds(rounds);
+    } else if (!(impl = salsa20_get_impl_rounds(version, rounds))) {
+        fprintf(stderr, "There is no implementation V%u for the salsa20/%u algorithm.\n", version, rounds);
+        return EXIT_FAILURE;
+    } else if (!salsa20_impl_supported(impl)) {
+        fprintf(stderr, "The CPU does not support the instructions needed by V%u.\n", version);
         return EXIT_FAILURE;
     }
 
-    core_func core_impl = getCoreImpl(version);
-    crypt_func crypt_impl = getCryptImpl(version);
-    const char* version_description = getVersionDescription(version);
+    core_func core_impl = impl->core;
+    crypt_func crypt_impl = impl->crypt;
+    const char* version_description = impl->description;
+
+    // Reduced round versions share the descriptions of Salsa20/20
+    char rounds_description[128];
+    if (rounds != 20) {
+        snprintf(rounds_description, sizeof(rounds_description), "%s, Salsa20/%u", impl->description, rounds);
+        version_description = rounds_description;
+    }
+
+    // The batch benchmark works on random records in memory instead of a file.
+    if (batch_max) {
+        size_t* lens = malloc(batch_count * sizeof(size_t));
+        uint8_t** records = malloc(batch_count * sizeof(uint8_t*));
+        uint64_t* ivs = malloc(batch_count * sizeof(uint64_t));
+        uint8_t* data = malloc(batch_count * batch_max);
+
+        if (!lens || !records || !ivs || !data) {
+            fprintf(stderr, "Could not allocate enough memory for %lu records of up to %lu bytes\n", batch_count, batch_max);
+            free(lens);
+            free(records);
+            free(ivs);
+            free(data);
+            return EXIT_FAILURE;
+        }
+
+        srand(time(NULL));
+        for (size_t m = 0; m < batch_count; m++) {
+            lens[m] = batch_min + (uint64_t) rand() % (batch_max - batch_min + 1);
+            records[m] = data + m * batch_max;
+            ivs[m] = iv + m;
+        }
+        for (size_t i = 0; i < batch_count * batch_max; i++) {
+            data[i] = rand();
+        }
+
+        // The records are en-/decrypted in place
+        performance_batch(run_perf ? iter : 100, crypt_impl, core_impl, batch_count, lens, (const uint8_t* const*) records, records, key, ivs, version_description);
+
+        free(lens);
+        free(records);
+        free(ivs);
+        free(data);
+        return EXIT_SUCCESS;
+    }
+
+    // Pipes, terminals and sockets can neither be read completely up front nor seeked, so they go through the threaded pipeline.
+    struct stat in_stat;
+    uint8_t in_std = !strcmp(in_path, "-");
+    uint8_t out_std = !strcmp(out_path, "-");
+
+    if ((in_std || out_std || (!stat(in_path, &in_stat) && !S_ISREG(in_stat.st_mode))) && !run_perf) {
+        if (in_place || use_mmap || uring_depth) {
+            fprintf(stderr, "--in-place, --mmap and --uring need regular files as input and output\n");
+            return EXIT_FAILURE;
+        }
+
+        int in_fd = in_std ? STDIN_FILENO : open(in_path, O_RDONLY);
+        if (in_fd < 0) {
+            fprintf(stderr, "Error opening file, no such file: %s\n", in_path);
+            return EXIT_FAILURE;
+        }
+
+        int out_fd = out_std ? STDOUT_FILENO : open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0) {
+            fprintf(stderr, "Error opening file: %s\n", out_path);
+            if (!in_std) {
+                close(in_fd);
+            }
+            return EXIT_FAILURE;
+        }
+
+        int ret = crypt_fd_pipeline(in_fd, out_fd, chunk_size, nthreads, crypt_impl, core_impl, key, iv, offset, has_length ? length : UINT64_MAX);
+
+        if (!out_std && close(out_fd)) {
+            fprintf(stderr, "Error writing to file: %s\n", out_path);
+            ret = EXIT_FAILURE;
+        }
+        if (!in_std) {
+            close(in_fd);
+        }
+        return ret;
+    }
+
+    // With more than one thread the chosen crypt implementation runs on spans of the message in parallel.
+    if (nthreads > 1) {
+        if (salsa20_parallel_init(nthreads, crypt_impl)) {
+            fprintf(stderr, "Could not create a pool of %lu threads\n", nthreads);
+            return EXIT_FAILURE;
+        }
+        crypt_impl = salsa20_crypt_parallel;
+    }
+
+    // In-place mode: the file itself is en-/decrypted, either mapped or chunk by chunk with pread/pwrite.
+    if (in_place && !run_perf) {
+        int ret = crypt_file_inplace(in_path, chunk_size, crypt_impl, core_impl, key, iv, offset, has_length ? length : UINT64_MAX);
+        salsa20_parallel_destroy();
+        return ret;
+    }
+
+    if ((chunk_size || uring_depth) && use_mmap) {
+        fprintf(stderr, "--chunk/--uring and --mmap can not be combined\n");
+        salsa20_parallel_destroy();
+        return EXIT_FAILURE;
+    }
+
+    // The io_uring file mode overlaps reading, en-/decrypting and writing of the chunks.
+    if (uring_depth && !run_perf) {
+        int ret = crypt_file_uring(in_path, out_path, chunk_size ? chunk_size : 1048576, uring_depth, crypt_impl, core_impl, key, iv, offset, has_length ? length : UINT64_MAX);
+        salsa20_parallel_destroy();
+        return ret;
+    }
+
+    // The mmap file mode en-/decrypts directly from the page cache of the input into the one of the output.
+    if (use_mmap && !run_perf) {
+        int ret = crypt_file_mmap(in_path, out_path, crypt_impl, core_impl, key, iv, offset, has_length ? length : UINT64_MAX);
+        salsa20_parallel_destroy();
+        return ret;
+    }
+
+    // The streaming file mode only keeps one chunk of the file in memory.
+    if (chunk_size && !run_perf) {
+        int ret = crypt_file_stream(in_path, out_path, chunk_size, crypt_impl, core_impl, key, iv, offset, has_length ? length : UINT64_MAX);
+        salsa20_parallel_destroy();
+        return ret;
+    }
 
     /*  Read contents of file from in_path and convert string to uint8_t array.
     *   Memory which was allocated by 'read_file' has to be freed.
@@ -381,16 +940,34 @@ int main(int argc, char** argv) {
     *   anymore both have to be freed (string first then struct).
     */
     if (!(filetext = read_file(in_path))) {
+        salsa20_parallel_destroy();
         return EXIT_FAILURE;
     }
 
+    // Only the slice [offset, offset + length) of the file is processed.
+    if (!has_length && offset < filetext->len) {
+        length = filetext->len - offset;
+    }
+
+    if (offset >= filetext->len || length == 0 || length > filetext->len - offset) {
+        fprintf(stderr, "--offset/--length: the selected slice is empty or not within the %lu bytes of %s\n", filetext->len, in_path);
+        salsa20_parallel_destroy();
+        free(filetext->str);
+        free(filetext);
+        return EXIT_FAILURE;
+    }
+
+    size_t mlen = length;
+    const uint8_t* msg = filetext->str + offset;
+
     uint8_t* cipher;
 
     /*  Tries to allocate memory for the en-/decrypted text. If the operation fails the
     *   memory which was allocated for the FileText struct has to be freed.
     */
-    if (!(cipher = malloc(filetext->len))) {
+    if (!(cipher = malloc(mlen))) {
         fprintf(stderr, "Could not allocate enough memory for cipher text\n");
+        salsa20_parallel_destroy();
         free(filetext->str);
         free(filetext);
         return EXIT_FAILURE;
@@ -401,10 +978,11 @@ int main(int argc, char** argv) {
     */
     if (!run_perf) {
         // Call salsa20_crypt to encrypt the message
-        crypt_impl(filetext->len, filetext->str, cipher, key, iv, core_impl);
+        crypt_impl(mlen, msg, cipher, key, iv, offset, core_impl);
 
         // If write_file returns a non zero value, then writing to the file failed. In this case return EXIT_FAILURE.
-        if (write_file(out_path, cipher, filetext->len) != 0) {
+        if (write_file(out_path, cipher, mlen) != 0) {
+            salsa20_parallel_destroy();
             free(filetext->str);
             free(filetext);
             free(cipher);
@@ -428,22 +1006,16 @@ int main(int argc, char** argv) {
             };
  	        uint32_t output[16];
 
-            const char* core_descriptions[4] = {
-                "Core_v0 (simple)",
-                "Core_v1 (SIMD)",
-                "Core_v2 (no transpose)",
-                "Core_v3 (optimized SIMD)",
-            };
-
             // Run performance test for core implementation
-            performance_core(iter, core_impl, output, input, core_descriptions[version%4]);
+            performance_core(iter, core_impl, output, input, impl->core_description);
         } else {
 
             // Run performance test for crypt implementation
-            performance(iter, crypt_impl, core_impl, filetext->len, filetext->str, cipher, key, iv, version_description);
+            performance(iter, crypt_impl, core_impl, mlen, msg, cipher, key, iv, offset, version_description);
         }
     }
 
+    salsa20_parallel_destroy();
     free(filetext->str);
     free(filetext);
     free(cipher);
@@ -11,6 +11,12 @@
 // Rotates 4 32 bit integers in a 128 bit variable (a) by (b) number of bits each
 #define ROTL_SIMD(a, b) (_mm_or_si128(_mm_slli_epi32((a), (b)), _mm_srli_epi32((a), (32 - (b)))))
 
+// Rotates 8 32 bit integers in a 256 bit variable (a) by (b) number of bits each (requires AVX2 and immintrin.h)
+#define ROTL_AVX2(a, b) (_mm256_or_si256(_mm256_slli_epi32((a), (b)), _mm256_srli_epi32((a), (32 - (b)))))
+
+// Rotates 16 32 bit integers in a 512 bit variable (a) by (b) number of bits each with a single VPROLD (requires AVX-512F and immintrin.h)
+#define ROTL_AVX512(a, b) (_mm512_rol_epi32((a), (b)))
+
 void transpose();
 
 void rotate_simd(uint32_t matrix[16]);
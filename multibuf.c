@@ -0,0 +1,121 @@
+#include <aio.h>
+#include <stdint.h>
+
+#include "core_x4.h"
+#include "core_x8.h"
+#include "crypt_util.h"
+#include "dispatch.h"
+#include "multibuf.h"
+
+/*  State of one lane of the multi-buffer crypt: the job it is working on and the
+*   number of bytes of that job that are done. The input matrix of the lane is kept
+*   separately, as the multi-buffer core expects all of them in one array.
+*/
+struct salsa20_lane {
+    const struct salsa20_job* job;
+    size_t pos;
+};
+
+// Takes the next job with at least one byte for the lane and sets up its input matrix. Returns 0 if no jobs are left.
+static int salsa20_lane_refill(struct salsa20_lane* lane, uint32_t input[16], const struct salsa20_job jobs[], size_t n, size_t* next_job) {
+    while (*next_job < n && jobs[*next_job].len == 0) {
+        (*next_job)++;
+    }
+
+    if (*next_job == n) {
+        lane->job = NULL;
+        return 0;
+    }
+
+    const struct salsa20_job* job = &jobs[(*next_job)++];
+    lane->job = job;
+    lane->pos = 0;
+
+    input[0] = 0x61707865;
+    input[5] = 0x3320646e;
+    input[10] = 0x79622d32;
+    input[15] = 0x6b206574;
+    for (size_t i = 0; i < 4; i++) {
+        input[1 + i] = job->key[i];
+        input[11 + i] = job->key[4 + i];
+    }
+    input[6] = job->iv & 0xffffffff;
+    input[7] = job->iv >> 32;
+    return 1;
+}
+
+/*  En-/decrypts n unrelated streams, each with its own key, nonce and key stream
+*   offset (see struct salsa20_job). Every lane of salsa20_core_x8_multi (AVX2) or
+*   salsa20_core_x4_multi carries the complete state of one stream. The streams
+*   advance in lockstep one block per core call, and as soon as a stream is done
+*   its lane is refilled with the next job, so the vector stays fully used even
+*   though no single stream is long. Only at the very end some lanes run idle.
+*   job.in == job.out is allowed.
+*/
+void salsa20_crypt_multi(size_t n, const struct salsa20_job jobs[]) {
+    size_t width = (cpu_features() & CPU_FEATURE_AVX2) ? 8 : 4;
+    struct salsa20_lane lanes[8];
+    uint32_t inputs[8][16] = { { 0 } };
+    uint32_t output[128];
+    size_t next_job = 0;
+    size_t active = 0;
+
+    for (size_t j = 0; j < width; j++) {
+        active += salsa20_lane_refill(&lanes[j], inputs[j], jobs, n, &next_job);
+    }
+
+    while (active) {
+        for (size_t j = 0; j < width; j++) {
+            if (lanes[j].job) {
+                uint64_t counter = (lanes[j].job->offset + lanes[j].pos) / 64;
+                inputs[j][8] = counter & 0xffffffff;
+                inputs[j][9] = counter >> 32;
+            }
+        }
+
+        // Once only four lanes are left the SSE2 core is enough
+        if (width == 8 && active > 4) {
+            salsa20_core_x8_multi(output, (const uint32_t (*)[16]) inputs);
+        } else if (width == 8) {
+            // Move the active lanes to the front for the four lane core
+            size_t k = 0;
+            for (size_t j = 0; j < width; j++) {
+                if (lanes[j].job) {
+                    if (k != j) {
+                        lanes[k] = lanes[j];
+                        lanes[j].job = NULL;
+                        for (size_t i = 0; i < 16; i++) {
+                            inputs[k][i] = inputs[j][i];
+                        }
+                    }
+                    k++;
+                }
+            }
+            width = 4;
+            salsa20_core_x4_multi(output, (const uint32_t (*)[16]) inputs);
+        } else {
+            salsa20_core_x4_multi(output, (const uint32_t (*)[16]) inputs);
+        }
+
+        for (size_t j = 0; j < width; j++) {
+            struct salsa20_lane* lane = &lanes[j];
+            const struct salsa20_job* job = lane->job;
+
+            if (!job) {
+                continue;
+            }
+
+            // The first block of a job may start within the block if its offset is not a multiple of 64
+            size_t skip = (job->offset + lane->pos) % 64;
+            size_t len = job->len - lane->pos < 64 - skip ? job->len - lane->pos : 64 - skip;
+            const uint8_t* key_byte_stream = (const uint8_t*) (output + 16 * j) + skip;
+
+            salsa20_xor_block(job->in + lane->pos, job->out + lane->pos, key_byte_stream, len);
+            lane->pos += len;
+
+            if (lane->pos == job->len && !salsa20_lane_refill(lane, inputs[j], jobs, n, &next_job)) {
+                active--;
+            }
+        }
+    }
+}
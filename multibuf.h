@@ -0,0 +1,19 @@
+#ifndef SALSA20_MULTIBUF_H
+#define SALSA20_MULTIBUF_H
+
+#include <aio.h>
+#include <stdint.h>
+
+// One independent stream of the multi-buffer crypt
+struct salsa20_job {
+    size_t len;
+    const uint8_t* in;
+    uint8_t* out;
+    uint32_t key[8];
+    uint64_t iv;
+    uint64_t offset;    // position of in[0] in the key stream
+};
+
+void salsa20_crypt_multi(size_t n, const struct salsa20_job jobs[]);
+
+#endif  // SALSA20_MULTIBUF_H
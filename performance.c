@@ -1,10 +1,19 @@
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "batch.h"
+#include "dispatch.h"
+#include "poly1305.h"
+#include "scrypt.h"
+#include "secretbox.h"
+#include "xsalsa20.h"
+
 typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
 
-typedef void (*crypt_func)(size_t mlen, const uint8_t[mlen], uint8_t[mlen], uint32_t[8], uint64_t, core_func);
+typedef void (*crypt_func)(size_t mlen, const uint8_t[mlen], uint8_t[mlen], uint32_t[8], uint64_t, uint64_t, core_func);
 
 /*
 * The performance tests are implemented according to the Benchmarking video in Week 7
@@ -24,11 +33,11 @@ void performance_core(uint64_t iter, core_func f, uint32_t output[16], const uin
     printf("%s took %f seconds to complete %ld iterations.\n", fname, time, iter);
 }
 
-void performance(uint64_t iter, crypt_func crypt, core_func core, size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, const char* fname){
+void performance(uint64_t iter, crypt_func crypt, core_func core, size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, const char* fname){
     struct timespec start;
     clock_gettime(CLOCK_MONOTONIC, &start);
     for (uint64_t i = 0; i < iter; i++) {
-        crypt(mlen,msg,cipher,key,iv,core);
+        crypt(mlen,msg,cipher,key,iv,offset,core);
     }
     struct timespec end;
     clock_gettime(CLOCK_MONOTONIC, &end);
@@ -39,3 +48,143 @@ void performance(uint64_t iter, crypt_func crypt, core_func core, size_t mlen, c
     printf("%s took %f seconds to complete %ld iterations.\n", fname, time, iter);
     printf("Encryption of message (%lu bytes) took %f seconds on average.\n", mlen, avg);
 }
+
+/*
+*   Compares the throughput of n records with independent nonces en-/decrypted one by one
+*   with the given crypt implementation and all at once with salsa20_crypt_batch.
+*/
+void performance_batch(uint64_t iter, crypt_func crypt, core_func core, size_t n, const size_t lens[], const uint8_t* const ins[], uint8_t* const outs[], uint32_t key[8], const uint64_t ivs[], const char* fname) {
+    size_t bytes = 0;
+    for (size_t m = 0; m < n; m++) {
+        bytes += lens[m];
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < iter; i++) {
+        for (size_t m = 0; m < n; m++) {
+            crypt(lens[m], ins[m], outs[m], key, ivs[m], 0, core);
+        }
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+    printf("%s took %f seconds for %ld iterations over %lu records (%lu bytes).\n", fname, time, iter, n, bytes);
+    printf("One call per record: %.0f records/s, %.1f MB/s\n", iter * n / time, iter * bytes / time / 1e6);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < iter; i++) {
+        salsa20_crypt_batch(n, lens, ins, outs, key, ivs);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+    printf("salsa20_crypt_batch:  %.0f records/s, %.1f MB/s\n", iter * n / time, iter * bytes / time / 1e6);
+}
+
+/*  Derives a 64 byte key with scrypt(N, r, p) iter times and reports the hashes per
+*   second. The password and the salt are those of the RFC 7914 vectors, their length
+*   hardly matters next to ROMix.
+*/
+int performance_scrypt(uint64_t iter, uint64_t N, uint32_t r, uint32_t p, size_t nthreads) {
+    uint8_t out[64];
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < iter; i++) {
+        if (scrypt((const uint8_t*) "password", 8, (const uint8_t*) "NaCl", 4, N, r, p, nthreads, out, sizeof(out))) {
+            return EXIT_FAILURE;
+        }
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+    printf("scrypt (N = %lu, r = %u, p = %u) took %f seconds to complete %ld iterations.\n", N, r, p, time, iter);
+    printf("%.2f hashes/s, %.0f MiB per lane\n", iter / time, 128.0 * r * N / (1 << 20));
+    return EXIT_SUCCESS;
+}
+
+/*  XSalsa20 on iter messages of mlen bytes that share the key and the nonce prefix, as
+*   on one connection: once with the cached subkey of xsalsa20_crypt and once with a
+*   call of hsalsa20 per message.
+*/
+void performance_xsalsa20(uint64_t iter, size_t mlen, uint8_t msg[mlen], uint32_t key[8]) {
+    const struct salsa20_impl* impl = salsa20_dispatch();
+    uint8_t nonce[24] = { 0 };
+    uint32_t subkey[8];
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < iter; i++) {
+        memcpy(nonce + 16, &i, sizeof(i));
+        xsalsa20_crypt(mlen, msg, msg, key, nonce, 0);
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+    printf("xsalsa20_crypt took %f seconds for %ld messages of %lu bytes.\n", time, iter, mlen);
+    printf("Cached subkey:     %.0f messages/s, %.1f MB/s\n", iter / time, iter * mlen / time / 1e6);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < iter; i++) {
+        hsalsa20(subkey, key, nonce);
+        impl->crypt(mlen, msg, msg, subkey, i, 0, impl->core);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+    printf("hsalsa20 per message: %.0f messages/s, %.1f MB/s\n", iter / time, iter * mlen / time / 1e6);
+}
+
+/*  XSalsa20-Poly1305 on a message of mlen bytes: secretbox_seal, which authenticates
+*   every tile while it is in L1, against xsalsa20_crypt followed by a separate
+*   Poly1305 pass over the cipher text. Poly1305 alone is measured as well.
+*/
+void performance_secretbox(uint64_t iter, size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8]) {
+    uint8_t nonce[SECRETBOX_NONCE_SIZE] = { 0 };
+    uint8_t mac_key[POLY1305_KEY_SIZE] = { 0 };
+    uint8_t tag[SECRETBOX_TAG_SIZE];
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < iter; i++) {
+        secretbox_seal(tag, cipher, msg, mlen, nonce, key);
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+    printf("secretbox_seal took %f seconds to complete %ld iterations over %lu bytes.\n", time, iter, mlen);
+    printf("Single pass:           %.1f MB/s\n", iter * mlen / time / 1e6);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < iter; i++) {
+        xsalsa20_crypt(sizeof(mac_key), mac_key, mac_key, key, nonce, 0);
+        xsalsa20_crypt(mlen, msg, cipher, key, nonce, 32);
+        poly1305(tag, cipher, mlen, mac_key);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+    printf("Crypt, then Poly1305:  %.1f MB/s\n", iter * mlen / time / 1e6);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < iter; i++) {
+        poly1305(tag, cipher, mlen, mac_key);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+    printf("Poly1305 only:         %.1f MB/s\n", iter * mlen / time / 1e6);
+}
@@ -1,14 +1,23 @@
 #ifndef PERFORMANCE_H
 #define PERFORMANCE_H
 
+#include <aio.h>
 #include <stdint.h>
 
 typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
 
-typedef void (*crypt_func)(size_t mlen, const uint8_t[mlen], uint8_t[mlen], uint32_t[8], uint64_t, core_func);
+typedef void (*crypt_func)(size_t mlen, const uint8_t[mlen], uint8_t[mlen], uint32_t[8], uint64_t, uint64_t, core_func);
 
 void performance_core(uint64_t iter, core_func f, uint32_t output[16], const uint32_t input[16], const char* fname);
 
-void performance(uint64_t iter, crypt_func crypt, core_func core, size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, const char* fname);
+void performance(uint64_t iter, crypt_func crypt, core_func core, size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8], uint64_t iv, uint64_t offset, const char* fname);
+
+void performance_batch(uint64_t iter, crypt_func crypt, core_func core, size_t n, const size_t lens[], const uint8_t* const ins[], uint8_t* const outs[], uint32_t key[8], const uint64_t ivs[], const char* fname);
+
+int performance_scrypt(uint64_t iter, uint64_t N, uint32_t r, uint32_t p, size_t nthreads);
+
+void performance_xsalsa20(uint64_t iter, size_t mlen, uint8_t msg[mlen], uint32_t key[8]);
+
+void performance_secretbox(uint64_t iter, size_t mlen, const uint8_t msg[mlen], uint8_t cipher[mlen], uint32_t key[8]);
 
 #endif
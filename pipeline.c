@@ -0,0 +1,422 @@
+#include <aio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <immintrin.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "pipeline.h"
+
+// Number of buffers per encryptor thread, has to be a power of two
+#define RING_SIZE 8
+
+// Default chunk size, the capacity of a pipe on Linux
+#define PIPELINE_CHUNK_SIZE 65536
+
+// Number of polls of a full or empty ring before the thread goes to sleep on its futex
+#define RING_SPIN 256
+
+// A buffer of the pipeline together with the position of its bytes within the slice
+struct chunk {
+    uint8_t* data;
+    size_t len;     // 0 marks the end of the input
+    uint64_t pos;
+};
+
+/*  Lock-free ring of chunk pointers for exactly one producer and one consumer. Only
+*   the producer writes tail and only the consumer writes head, so the release store
+*   of one index and the acquire load by the other thread are the only
+*   synchronisation needed. Both live on their own cache line.
+*
+*   A thread that finds the ring full or empty for a while sleeps on the futex seq,
+*   which is incremented on every push and pop. prod_waiting and cons_waiting tell the
+*   other side that it has to wake the sleeper, so the fast path stays free of system
+*   calls. Each side only ever writes its own flag.
+*/
+struct spsc_ring {
+    size_t head __attribute__((aligned(64)));
+    size_t tail __attribute__((aligned(64)));
+    uint32_t seq __attribute__((aligned(64)));
+    uint32_t prod_waiting;  // the producer sleeps because the ring is full
+    uint32_t cons_waiting;  // the consumer sleeps because the ring is empty
+    struct chunk* slots[RING_SIZE];
+};
+
+/*  Every encryptor thread owns a lane with RING_SIZE preallocated buffers. The buffers
+*   travel from the reader (in) to the encryptor (out) to the writer and back to the
+*   reader (free), so each of the three rings has a single producer and consumer.
+*/
+struct lane {
+    struct spsc_ring free;
+    struct spsc_ring in;
+    struct spsc_ring out;
+    struct chunk chunks[RING_SIZE];
+    struct pipeline* pipeline;
+    pthread_t thread;
+};
+
+struct pipeline {
+    int in_fd;
+    int out_fd;
+    size_t chunk_size;
+    size_t nlanes;
+    struct lane* lanes;
+    crypt_func crypt;
+    core_func core;
+    uint32_t* key;
+    uint64_t iv;
+    uint64_t offset;
+    uint64_t length;
+    int error;      // set by any stage, makes all of them stop
+};
+
+static void futex_wait(uint32_t* addr, uint32_t val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t* addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// Announces a change of the ring and wakes the other side if it sleeps (or is about to)
+static void ring_notify(struct spsc_ring* ring, uint32_t* other_waiting) {
+    __atomic_fetch_add(&ring->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(other_waiting, __ATOMIC_SEQ_CST)) {
+        futex_wake(&ring->seq);
+    }
+}
+
+static int ring_push(struct spsc_ring* ring, struct chunk* chunk) {
+    size_t tail = ring->tail;
+
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == RING_SIZE) {
+        return 0;
+    }
+
+    ring->slots[tail % RING_SIZE] = chunk;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    ring_notify(ring, &ring->cons_waiting);
+    return 1;
+}
+
+static struct chunk* ring_pop(struct spsc_ring* ring) {
+    size_t head = ring->head;
+
+    if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    struct chunk* chunk = ring->slots[head % RING_SIZE];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    ring_notify(ring, &ring->prod_waiting);
+    return chunk;
+}
+
+static int pipeline_failed(struct pipeline* p) {
+    return __atomic_load_n(&p->error, __ATOMIC_ACQUIRE);
+}
+
+// Makes all stages stop and wakes the ones that sleep on a ring
+static void pipeline_fail(struct pipeline* p) {
+    __atomic_store_n(&p->error, 1, __ATOMIC_SEQ_CST);
+
+    for (size_t i = 0; i < p->nlanes; i++) {
+        struct spsc_ring* rings[] = { &p->lanes[i].free, &p->lanes[i].in, &p->lanes[i].out };
+        for (size_t j = 0; j < 3; j++) {
+            __atomic_fetch_add(&rings[j]->seq, 1, __ATOMIC_SEQ_CST);
+            futex_wake(&rings[j]->seq);
+        }
+    }
+}
+
+/*  Waits for a change of the ring that was full or empty: spins RING_SPIN times, then
+*   sleeps on the futex. The ring and the error flag are checked again after the own
+*   flag waiting (prod_waiting or cons_waiting) was set, so a push, pop or failure in
+*   between either is seen there or wakes the thread (or changes seq, so futex_wait
+*   returns at once). Returns -1 if another stage failed.
+*/
+static int ring_wait(struct pipeline* p, struct spsc_ring* ring, uint32_t* waiting, size_t* spins, int (*ready)(struct spsc_ring*)) {
+    if (pipeline_failed(p)) {
+        return -1;
+    }
+    if ((*spins)++ < RING_SPIN) {
+        _mm_pause();
+        return 0;
+    }
+
+    uint32_t seq = __atomic_load_n(&ring->seq, __ATOMIC_SEQ_CST);
+    __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+
+    if (!ready(ring) && !pipeline_failed(p)) {
+        futex_wait(&ring->seq, seq);
+    }
+    __atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static int ring_not_full(struct spsc_ring* ring) {
+    return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != RING_SIZE;
+}
+
+static int ring_not_empty(struct spsc_ring* ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+// Pushes the chunk, waiting while the ring is full. Returns -1 if another stage failed.
+static int ring_push_wait(struct pipeline* p, struct spsc_ring* ring, struct chunk* chunk) {
+    size_t spins = 0;
+
+    while (!ring_push(ring, chunk)) {
+        if (ring_wait(p, ring, &ring->prod_waiting, &spins, ring_not_full)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Pops a chunk, waiting while the ring is empty. Returns NULL if another stage failed.
+static struct chunk* ring_pop_wait(struct pipeline* p, struct spsc_ring* ring) {
+    struct chunk* chunk;
+    size_t spins = 0;
+
+    while (!(chunk = ring_pop(ring))) {
+        if (ring_wait(p, ring, &ring->cons_waiting, &spins, ring_not_empty)) {
+            return NULL;
+        }
+    }
+    return chunk;
+}
+
+/*  Reader stage: fills the free buffers of the lanes round-robin with whatever a
+*   single read returns, so a slow pipe does not hold back data that is already
+*   there. At the end of the input every lane gets an empty chunk, which stops its
+*   encryptor and (for the first one in order) the writer.
+*/
+static void* pipeline_reader(void* arg) {
+    struct pipeline* p = arg;
+    uint64_t pos = 0;
+    size_t k = 0;
+
+    while (1) {
+        struct lane* lane = &p->lanes[k++ % p->nlanes];
+        struct chunk* chunk;
+
+        if (!(chunk = ring_pop_wait(p, &lane->free))) {
+            return NULL;
+        }
+
+        size_t want = p->length - pos < p->chunk_size ? p->length - pos : p->chunk_size;
+        ssize_t got = 0;
+        while (want && (got = read(p->in_fd, chunk->data, want)) < 0 && errno == EINTR) {
+        }
+
+        if (got < 0) {
+            fprintf(stderr, "Error reading contents from input: %s\n", strerror(errno));
+            pipeline_fail(p);
+            return NULL;
+        }
+
+        if (!got && p->length != UINT64_MAX && pos < p->length) {
+            fprintf(stderr, "--offset/--length: the selected slice is not within the %lu bytes of the input\n", p->offset + pos);
+            pipeline_fail(p);
+            return NULL;
+        }
+
+        chunk->len = got;
+        chunk->pos = pos;
+        pos += got;
+
+        if (ring_push_wait(p, &lane->in, chunk)) {
+            return NULL;
+        }
+
+        if (!got) {
+            break;
+        }
+    }
+
+    for (size_t i = 1; i < p->nlanes; i++) {
+        struct lane* lane = &p->lanes[k++ % p->nlanes];
+        struct chunk* chunk;
+
+        if (!(chunk = ring_pop_wait(p, &lane->free))) {
+            return NULL;
+        }
+        chunk->len = 0;
+        if (ring_push_wait(p, &lane->in, chunk)) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// Encryptor stage: en-/decrypts the chunks of one lane in place at their position in the key stream
+static void* pipeline_encryptor(void* arg) {
+    struct lane* lane = arg;
+    struct pipeline* p = lane->pipeline;
+
+    while (1) {
+        struct chunk* chunk;
+
+        if (!(chunk = ring_pop_wait(p, &lane->in))) {
+            return NULL;
+        }
+
+        // Once pushed, the chunk belongs to the writer and may already be refilled by the reader
+        size_t len = chunk->len;
+        if (len) {
+            p->crypt(len, chunk->data, chunk->data, p->key, p->iv, p->offset + chunk->pos, p->core);
+        }
+
+        if (ring_push_wait(p, &lane->out, chunk) || !len) {
+            return NULL;
+        }
+    }
+}
+
+// Writer stage: takes the chunks from the lanes in the same round-robin order as the reader, so the output stays in order
+static int pipeline_writer(struct pipeline* p) {
+    size_t k = 0;
+
+    while (1) {
+        struct lane* lane = &p->lanes[k++ % p->nlanes];
+        struct chunk* chunk;
+
+        if (!(chunk = ring_pop_wait(p, &lane->out))) {
+            return -1;
+        }
+
+        if (!chunk->len) {
+            return 0;
+        }
+
+        size_t done = 0;
+        while (done < chunk->len) {
+            ssize_t put = write(p->out_fd, chunk->data + done, chunk->len - done);
+            if (put < 0 && errno == EINTR) {
+                continue;
+            } else if (put <= 0) {
+                fprintf(stderr, "Error writing to output: %s\n", strerror(errno));
+                pipeline_fail(p);
+                return -1;
+            }
+            done += put;
+        }
+
+        if (ring_push_wait(p, &lane->free, chunk)) {
+            return -1;
+        }
+    }
+}
+
+// Reads and drops the first offset bytes of the input, which can not be skipped with a seek on a pipe
+static int pipeline_skip(struct pipeline* p, uint8_t* scratch) {
+    uint64_t skipped = 0;
+
+    while (skipped < p->offset) {
+        size_t want = p->offset - skipped < p->chunk_size ? p->offset - skipped : p->chunk_size;
+        ssize_t got = read(p->in_fd, scratch, want);
+
+        if (got < 0 && errno == EINTR) {
+            continue;
+        } else if (got < 0) {
+            fprintf(stderr, "Error reading contents from input: %s\n", strerror(errno));
+            return -1;
+        } else if (got == 0) {
+            fprintf(stderr, "--offset: the input ends after %lu bytes\n", skipped);
+            return -1;
+        }
+        skipped += got;
+    }
+    return 0;
+}
+
+/*
+*   En-/decrypts everything read from in_fd and writes it to out_fd, which may be pipes,
+*   terminals or sockets as well as regular files. A reader thread fills buffers of
+*   chunk_size bytes (0 selects a default), nthreads encryptor threads run the crypt
+*   implementation on them at their known key stream position and the calling thread
+*   writes them out in order. The stages are connected by lock-free single producer,
+*   single consumer rings with preallocated buffers.
+*
+*   The first offset bytes of the input are dropped and at most length bytes after them
+*   are processed (UINT64_MAX for everything up to the end of the input), en-/decrypted
+*   with the key stream from byte offset on. Returns EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int crypt_fd_pipeline(int in_fd, int out_fd, size_t chunk_size, size_t nthreads, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length) {
+    struct pipeline p = {
+        .in_fd = in_fd, .out_fd = out_fd,
+        .chunk_size = chunk_size ? chunk_size : PIPELINE_CHUNK_SIZE,
+        .nlanes = nthreads ? nthreads : 1,
+        .crypt = crypt, .core = core, .key = key, .iv = iv,
+        .offset = offset, .length = length, .error = 0
+    };
+    int suc = EXIT_FAILURE;
+    size_t started = 0;
+    pthread_t reader;
+
+    if (!(p.lanes = aligned_alloc(64, p.nlanes * sizeof(struct lane)))) {
+        fprintf(stderr, "Could not allocate enough memory for %lu encryptor threads\n", p.nlanes);
+        return EXIT_FAILURE;
+    }
+    memset(p.lanes, 0, p.nlanes * sizeof(struct lane));
+
+    for (size_t i = 0; i < p.nlanes; i++) {
+        struct lane* lane = &p.lanes[i];
+        lane->pipeline = &p;
+
+        for (size_t j = 0; j < RING_SIZE; j++) {
+            if (!(lane->chunks[j].data = malloc(p.chunk_size))) {
+                fprintf(stderr, "Could not allocate enough memory for a chunk of %lu bytes\n", p.chunk_size);
+                goto cleanup;
+            }
+            ring_push(&lane->free, &lane->chunks[j]);
+        }
+    }
+
+    if (pipeline_skip(&p, p.lanes[0].chunks[0].data)) {
+        goto cleanup;
+    }
+
+    for (; started < p.nlanes; started++) {
+        if (pthread_create(&p.lanes[started].thread, NULL, pipeline_encryptor, &p.lanes[started])) {
+            fprintf(stderr, "Could not create encryptor thread %lu\n", started);
+            pipeline_fail(&p);
+            goto join;
+        }
+    }
+
+    if (pthread_create(&reader, NULL, pipeline_reader, &p)) {
+        fprintf(stderr, "Could not create the reader thread\n");
+        pipeline_fail(&p);
+        goto join;
+    }
+
+    if (!pipeline_writer(&p)) {
+        suc = EXIT_SUCCESS;
+    } else {
+        // The reader may be blocked in read() on an input that never delivers again
+        pthread_cancel(reader);
+    }
+    pthread_join(reader, NULL);
+
+join:
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(p.lanes[i].thread, NULL);
+    }
+
+cleanup:
+    for (size_t i = 0; i < p.nlanes; i++) {
+        for (size_t j = 0; j < RING_SIZE; j++) {
+            free(p.lanes[i].chunks[j].data);
+        }
+    }
+    free(p.lanes);
+    return suc;
+}
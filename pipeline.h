@@ -0,0 +1,12 @@
+#ifndef SALSA20_PIPELINE_H
+#define SALSA20_PIPELINE_H
+
+#include <aio.h>
+#include <stdint.h>
+
+typedef void (*core_func)(uint32_t[16], const uint32_t[16]);
+typedef void (*crypt_func)(size_t, const uint8_t[], uint8_t[], uint32_t[8], uint64_t, uint64_t, core_func);
+
+int crypt_fd_pipeline(int in_fd, int out_fd, size_t chunk_size, size_t nthreads, crypt_func crypt, core_func core, uint32_t key[8], uint64_t iv, uint64_t offset, uint64_t length);
+
+#endif  // SALSA20_PIPELINE_H
@@ -0,0 +1,397 @@
+#include <aio.h>
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "dispatch.h"
+#include "poly1305.h"
+
+/*  Poly1305 (RFC 8439): the message is split into 16 byte blocks, each block with a
+*   1 appended is added to the accumulator h, which is then multiplied by the clamped
+*   key half r modulo p = 2^130 - 5. The tag is h + s modulo 2^128.
+*
+*   All numbers are kept in radix 2^26 (poly1305-donna-32). Since 2^130 = 5 mod p, the
+*   limbs of a product above 2^130 fold back multiplied by 5, that is what the s
+*   factors (5 * r[i]) in the multiplications are for.
+*
+*   The vectorized code processes w = 2 (SSE2) or 4 (AVX2) blocks in parallel, one per
+*   64 bit lane: lane j accumulates the blocks j, j + w, j + 2w, ... with h = h * r^w + m.
+*   At the end lane j is multiplied by r^(w - j) and the lanes are added up, which gives
+*   the same polynomial as the block by block evaluation.
+*/
+
+#define POLY1305_MASK 0x3ffffff
+
+// The 2^128 bit of every full block
+#define POLY1305_HIBIT (1 << 24)
+
+// Fewer blocks are left to the scalar code, the final combination of the lanes would not pay off
+#define POLY1305_SIMD_MIN_BLOCKS 8
+
+static inline uint32_t poly1305_le32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Partial reduction of the five 64 bit limbs of a product to h (h[1] may exceed 26 bits by a few bits)
+static inline void poly1305_carry(uint32_t h[5], uint64_t d[5]) {
+    uint64_t c;
+
+    c = d[0] >> 26; h[0] = d[0] & POLY1305_MASK; d[1] += c;
+    c = d[1] >> 26; h[1] = d[1] & POLY1305_MASK; d[2] += c;
+    c = d[2] >> 26; h[2] = d[2] & POLY1305_MASK; d[3] += c;
+    c = d[3] >> 26; h[3] = d[3] & POLY1305_MASK; d[4] += c;
+    c = d[4] >> 26; h[4] = d[4] & POLY1305_MASK;
+
+    uint64_t h0 = h[0] + c * 5;
+    h[0] = h0 & POLY1305_MASK;
+    h[1] += h0 >> 26;
+}
+
+// h = h * r mod p
+static void poly1305_mul(uint32_t h[5], const uint32_t r[5]) {
+    uint64_t s1 = r[1] * 5, s2 = r[2] * 5, s3 = r[3] * 5, s4 = r[4] * 5;
+    uint64_t d[5];
+
+    d[0] = (uint64_t) h[0] * r[0] + h[1] * s4 + h[2] * s3 + h[3] * s2 + h[4] * s1;
+    d[1] = (uint64_t) h[0] * r[1] + (uint64_t) h[1] * r[0] + h[2] * s4 + h[3] * s3 + h[4] * s2;
+    d[2] = (uint64_t) h[0] * r[2] + (uint64_t) h[1] * r[1] + (uint64_t) h[2] * r[0] + h[3] * s4 + h[4] * s3;
+    d[3] = (uint64_t) h[0] * r[3] + (uint64_t) h[1] * r[2] + (uint64_t) h[2] * r[1] + (uint64_t) h[3] * r[0] + h[4] * s4;
+    d[4] = (uint64_t) h[0] * r[4] + (uint64_t) h[1] * r[3] + (uint64_t) h[2] * r[2] + (uint64_t) h[3] * r[1] + (uint64_t) h[4] * r[0];
+
+    poly1305_carry(h, d);
+}
+
+// Scalar path: adds every block (hibit is 0 for the padded last block) and multiplies by r
+static void poly1305_blocks(struct poly1305_ctx* ctx, const uint8_t* msg, size_t nblocks, uint32_t hibit) {
+    uint32_t* h = ctx->h;
+
+    for (size_t i = 0; i < nblocks; i++, msg += POLY1305_BLOCK_SIZE) {
+        h[0] += poly1305_le32(msg) & POLY1305_MASK;
+        h[1] += (poly1305_le32(msg + 3) >> 2) & POLY1305_MASK;
+        h[2] += (poly1305_le32(msg + 6) >> 4) & POLY1305_MASK;
+        h[3] += (poly1305_le32(msg + 9) >> 6) & POLY1305_MASK;
+        h[4] += (poly1305_le32(msg + 12) >> 8) | hibit;
+        poly1305_mul(h, ctx->r[0]);
+    }
+}
+
+// Limbs of two blocks, one per 64 bit lane
+static inline void poly1305_load_x2(__m128i m[5], const uint8_t* msg) {
+    __m128i a = _mm_loadu_si128((const __m128i_u*) msg);
+    __m128i b = _mm_loadu_si128((const __m128i_u*) (msg + 16));
+    __m128i lo = _mm_unpacklo_epi64(a, b);
+    __m128i hi = _mm_unpackhi_epi64(a, b);
+    __m128i mask = _mm_set1_epi64x(POLY1305_MASK);
+
+    m[0] = _mm_and_si128(lo, mask);
+    m[1] = _mm_and_si128(_mm_srli_epi64(lo, 26), mask);
+    m[2] = _mm_and_si128(_mm_or_si128(_mm_srli_epi64(lo, 52), _mm_slli_epi64(hi, 12)), mask);
+    m[3] = _mm_and_si128(_mm_srli_epi64(hi, 14), mask);
+    m[4] = _mm_or_si128(_mm_srli_epi64(hi, 40), _mm_set1_epi64x(POLY1305_HIBIT));
+}
+
+// d = h * r lane by lane, r and s = 5 * r in the low 32 bits of the lanes
+static inline void poly1305_product_x2(__m128i d[5], const __m128i h[5], const __m128i r[5], const __m128i s[5]) {
+    #define MUL(a, b) _mm_mul_epu32(a, b)
+    d[0] = _mm_add_epi64(_mm_add_epi64(_mm_add_epi64(MUL(h[0], r[0]), MUL(h[1], s[4])), _mm_add_epi64(MUL(h[2], s[3]), MUL(h[3], s[2]))), MUL(h[4], s[1]));
+    d[1] = _mm_add_epi64(_mm_add_epi64(_mm_add_epi64(MUL(h[0], r[1]), MUL(h[1], r[0])), _mm_add_epi64(MUL(h[2], s[4]), MUL(h[3], s[3]))), MUL(h[4], s[2]));
+    d[2] = _mm_add_epi64(_mm_add_epi64(_mm_add_epi64(MUL(h[0], r[2]), MUL(h[1], r[1])), _mm_add_epi64(MUL(h[2], r[0]), MUL(h[3], s[4]))), MUL(h[4], s[3]));
+    d[3] = _mm_add_epi64(_mm_add_epi64(_mm_add_epi64(MUL(h[0], r[3]), MUL(h[1], r[2])), _mm_add_epi64(MUL(h[2], r[1]), MUL(h[3], r[0]))), MUL(h[4], s[4]));
+    d[4] = _mm_add_epi64(_mm_add_epi64(_mm_add_epi64(MUL(h[0], r[4]), MUL(h[1], r[3])), _mm_add_epi64(MUL(h[2], r[2]), MUL(h[3], r[1]))), MUL(h[4], r[0]));
+    #undef MUL
+}
+
+// Partial reduction in every lane, like poly1305_carry
+static inline void poly1305_carry_x2(__m128i h[5], __m128i d[5]) {
+    __m128i mask = _mm_set1_epi64x(POLY1305_MASK);
+    __m128i c;
+
+    for (size_t i = 0; i < 4; i++) {
+        c = _mm_srli_epi64(d[i], 26);
+        h[i] = _mm_and_si128(d[i], mask);
+        d[i + 1] = _mm_add_epi64(d[i + 1], c);
+    }
+    c = _mm_srli_epi64(d[4], 26);
+    h[4] = _mm_and_si128(d[4], mask);
+    h[0] = _mm_add_epi64(h[0], _mm_add_epi64(c, _mm_slli_epi64(c, 2)));
+
+    c = _mm_srli_epi64(h[0], 26);
+    h[0] = _mm_and_si128(h[0], mask);
+    h[1] = _mm_add_epi64(h[1], c);
+}
+
+/*  SSE2 path for an even number of blocks (at least two). The accumulator of the
+*   context joins the first lane and the combined result is written back to it.
+*/
+static void poly1305_blocks_x2(struct poly1305_ctx* ctx, const uint8_t* msg, size_t nblocks) {
+    __m128i r[5], s[5], h[5], m[5], d[5];
+
+    for (size_t i = 0; i < 5; i++) {
+        r[i] = _mm_set1_epi64x(ctx->r[1][i]);
+        s[i] = _mm_set1_epi64x(ctx->r[1][i] * 5);
+    }
+
+    poly1305_load_x2(h, msg);
+    for (size_t i = 0; i < 5; i++) {
+        h[i] = _mm_add_epi64(h[i], _mm_set_epi64x(0, ctx->h[i]));
+    }
+
+    for (size_t n = 2; n < nblocks; n += 2) {
+        poly1305_product_x2(d, h, r, s);
+        poly1305_carry_x2(h, d);
+        poly1305_load_x2(m, msg + 16 * n);
+        for (size_t i = 0; i < 5; i++) {
+            h[i] = _mm_add_epi64(h[i], m[i]);
+        }
+    }
+
+    // Lane 0 by r^2, lane 1 by r, then the sum of the lanes
+    for (size_t i = 0; i < 5; i++) {
+        r[i] = _mm_set_epi64x(ctx->r[0][i], ctx->r[1][i]);
+        s[i] = _mm_set_epi64x(ctx->r[0][i] * 5, ctx->r[1][i] * 5);
+    }
+    poly1305_product_x2(d, h, r, s);
+
+    uint64_t sum[5];
+    for (size_t i = 0; i < 5; i++) {
+        sum[i] = _mm_cvtsi128_si64(_mm_add_epi64(d[i], _mm_unpackhi_epi64(d[i], d[i])));
+    }
+    poly1305_carry(ctx->h, sum);
+}
+
+// AVX2 version of poly1305_load_x2 for four blocks
+__attribute__((target("avx2")))
+static inline void poly1305_load_x4(__m256i m[5], const uint8_t* msg) {
+    __m256i a = _mm256_loadu_si256((const __m256i_u*) msg);
+    __m256i b = _mm256_loadu_si256((const __m256i_u*) (msg + 32));
+
+    // unpack leaves the blocks in the order 0, 2, 1, 3
+    __m256i lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xd8);
+    __m256i hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xd8);
+    __m256i mask = _mm256_set1_epi64x(POLY1305_MASK);
+
+    m[0] = _mm256_and_si256(lo, mask);
+    m[1] = _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask);
+    m[2] = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52), _mm256_slli_epi64(hi, 12)), mask);
+    m[3] = _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask);
+    m[4] = _mm256_or_si256(_mm256_srli_epi64(hi, 40), _mm256_set1_epi64x(POLY1305_HIBIT));
+}
+
+__attribute__((target("avx2")))
+static inline void poly1305_product_x4(__m256i d[5], const __m256i h[5], const __m256i r[5], const __m256i s[5]) {
+    #define MUL(a, b) _mm256_mul_epu32(a, b)
+    d[0] = _mm256_add_epi64(_mm256_add_epi64(_mm256_add_epi64(MUL(h[0], r[0]), MUL(h[1], s[4])), _mm256_add_epi64(MUL(h[2], s[3]), MUL(h[3], s[2]))), MUL(h[4], s[1]));
+    d[1] = _mm256_add_epi64(_mm256_add_epi64(_mm256_add_epi64(MUL(h[0], r[1]), MUL(h[1], r[0])), _mm256_add_epi64(MUL(h[2], s[4]), MUL(h[3], s[3]))), MUL(h[4], s[2]));
+    d[2] = _mm256_add_epi64(_mm256_add_epi64(_mm256_add_epi64(MUL(h[0], r[2]), MUL(h[1], r[1])), _mm256_add_epi64(MUL(h[2], r[0]), MUL(h[3], s[4]))), MUL(h[4], s[3]));
+    d[3] = _mm256_add_epi64(_mm256_add_epi64(_mm256_add_epi64(MUL(h[0], r[3]), MUL(h[1], r[2])), _mm256_add_epi64(MUL(h[2], r[1]), MUL(h[3], r[0]))), MUL(h[4], s[4]));
+    d[4] = _mm256_add_epi64(_mm256_add_epi64(_mm256_add_epi64(MUL(h[0], r[4]), MUL(h[1], r[3])), _mm256_add_epi64(MUL(h[2], r[2]), MUL(h[3], r[1]))), MUL(h[4], r[0]));
+    #undef MUL
+}
+
+__attribute__((target("avx2")))
+static inline void poly1305_carry_x4(__m256i h[5], __m256i d[5]) {
+    __m256i mask = _mm256_set1_epi64x(POLY1305_MASK);
+    __m256i c;
+
+    for (size_t i = 0; i < 4; i++) {
+        c = _mm256_srli_epi64(d[i], 26);
+        h[i] = _mm256_and_si256(d[i], mask);
+        d[i + 1] = _mm256_add_epi64(d[i + 1], c);
+    }
+    c = _mm256_srli_epi64(d[4], 26);
+    h[4] = _mm256_and_si256(d[4], mask);
+    h[0] = _mm256_add_epi64(h[0], _mm256_add_epi64(c, _mm256_slli_epi64(c, 2)));
+
+    c = _mm256_srli_epi64(h[0], 26);
+    h[0] = _mm256_and_si256(h[0], mask);
+    h[1] = _mm256_add_epi64(h[1], c);
+}
+
+/*  AVX2 version of poly1305_blocks_x2 for a multiple of four blocks. The function is
+*   compiled for AVX2 only, the caller has to make sure that the CPU supports it.
+*/
+__attribute__((target("avx2")))
+static void poly1305_blocks_x4(struct poly1305_ctx* ctx, const uint8_t* msg, size_t nblocks) {
+    __m256i r[5], s[5], h[5], m[5], d[5];
+
+    for (size_t i = 0; i < 5; i++) {
+        r[i] = _mm256_set1_epi64x(ctx->r[3][i]);
+        s[i] = _mm256_set1_epi64x(ctx->r[3][i] * 5);
+    }
+
+    poly1305_load_x4(h, msg);
+    for (size_t i = 0; i < 5; i++) {
+        h[i] = _mm256_add_epi64(h[i], _mm256_setr_epi64x(ctx->h[i], 0, 0, 0));
+    }
+
+    for (size_t n = 4; n < nblocks; n += 4) {
+        poly1305_product_x4(d, h, r, s);
+        poly1305_carry_x4(h, d);
+        poly1305_load_x4(m, msg + 16 * n);
+        for (size_t i = 0; i < 5; i++) {
+            h[i] = _mm256_add_epi64(h[i], m[i]);
+        }
+    }
+
+    // Lane j by r^(4 - j), then the sum of the lanes
+    for (size_t i = 0; i < 5; i++) {
+        r[i] = _mm256_setr_epi64x(ctx->r[3][i], ctx->r[2][i], ctx->r[1][i], ctx->r[0][i]);
+        s[i] = _mm256_setr_epi64x(ctx->r[3][i] * 5, ctx->r[2][i] * 5, ctx->r[1][i] * 5, ctx->r[0][i] * 5);
+    }
+    poly1305_product_x4(d, h, r, s);
+
+    uint64_t sum[5];
+    for (size_t i = 0; i < 5; i++) {
+        __m128i half = _mm_add_epi64(_mm256_castsi256_si128(d[i]), _mm256_extracti128_si256(d[i], 1));
+        sum[i] = _mm_cvtsi128_si64(_mm_add_epi64(half, _mm_unpackhi_epi64(half, half)));
+    }
+    poly1305_carry(ctx->h, sum);
+}
+
+/*  Initializes the context with the one-time key: r (clamped) from the first 16
+*   bytes, s from the last 16. The vectorized code is chosen from the given CPU features
+*   (CPU_FEATURE_AVX2: four blocks, CPU_FEATURE_SSE2: two blocks, else scalar only).
+*/
+void poly1305_init_features(struct poly1305_ctx* ctx, const uint8_t key[POLY1305_KEY_SIZE], uint32_t features) {
+    ctx->r[0][0] = poly1305_le32(key) & 0x3ffffff;
+    ctx->r[0][1] = (poly1305_le32(key + 3) >> 2) & 0x3ffff03;
+    ctx->r[0][2] = (poly1305_le32(key + 6) >> 4) & 0x3ffc0ff;
+    ctx->r[0][3] = (poly1305_le32(key + 9) >> 6) & 0x3f03fff;
+    ctx->r[0][4] = (poly1305_le32(key + 12) >> 8) & 0x00fffff;
+
+    // r^2, r^3 and r^4 for the lanes of the vectorized code
+    for (size_t k = 1; k < 4; k++) {
+        memcpy(ctx->r[k], ctx->r[k - 1], sizeof(ctx->r[k]));
+        poly1305_mul(ctx->r[k], ctx->r[0]);
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        ctx->pad[i] = poly1305_le32(key + 16 + 4 * i);
+    }
+    memset(ctx->h, 0, sizeof(ctx->h));
+    ctx->buflen = 0;
+
+    if (features & CPU_FEATURE_AVX2) {
+        ctx->simd_width = 4;
+    } else if (features & CPU_FEATURE_SSE2) {
+        ctx->simd_width = 2;
+    } else {
+        ctx->simd_width = 0;
+    }
+}
+
+// Initializes the context for the widest vectorized code the CPU supports
+void poly1305_init(struct poly1305_ctx* ctx, const uint8_t key[POLY1305_KEY_SIZE]) {
+    poly1305_init_features(ctx, key, cpu_features());
+}
+
+/*  Adds len bytes of the message. Like salsa20_update the calls can be split
+*   arbitrarily, a partial block is buffered until the next call or poly1305_final.
+*/
+void poly1305_update(struct poly1305_ctx* ctx, const uint8_t* msg, size_t len) {
+    if (ctx->buflen) {
+        size_t n = POLY1305_BLOCK_SIZE - ctx->buflen < len ? POLY1305_BLOCK_SIZE - ctx->buflen : len;
+        memcpy(ctx->buf + ctx->buflen, msg, n);
+        ctx->buflen += n;
+        msg += n;
+        len -= n;
+        if (ctx->buflen < POLY1305_BLOCK_SIZE) {
+            return;
+        }
+        poly1305_blocks(ctx, ctx->buf, 1, POLY1305_HIBIT);
+        ctx->buflen = 0;
+    }
+
+    size_t nblocks = len / POLY1305_BLOCK_SIZE;
+
+    if (ctx->simd_width && nblocks >= POLY1305_SIMD_MIN_BLOCKS) {
+        size_t n = nblocks - nblocks % ctx->simd_width;
+        if (ctx->simd_width == 4) {
+            poly1305_blocks_x4(ctx, msg, n);
+        } else {
+            poly1305_blocks_x2(ctx, msg, n);
+        }
+        msg += n * POLY1305_BLOCK_SIZE;
+        len -= n * POLY1305_BLOCK_SIZE;
+        nblocks -= n;
+    }
+
+    poly1305_blocks(ctx, msg, nblocks, POLY1305_HIBIT);
+    msg += nblocks * POLY1305_BLOCK_SIZE;
+    len -= nblocks * POLY1305_BLOCK_SIZE;
+
+    memcpy(ctx->buf, msg, len);
+    ctx->buflen = len;
+}
+
+// Writes the tag and wipes the context
+void poly1305_final(struct poly1305_ctx* ctx, uint8_t tag[POLY1305_TAG_SIZE]) {
+    uint32_t* h = ctx->h;
+    uint32_t g[5];
+    uint32_t c;
+
+    // The last partial block gets its 1 right behind the message instead of at 2^128
+    if (ctx->buflen) {
+        ctx->buf[ctx->buflen] = 1;
+        memset(ctx->buf + ctx->buflen + 1, 0, POLY1305_BLOCK_SIZE - ctx->buflen - 1);
+        poly1305_blocks(ctx, ctx->buf, 1, 0);
+    }
+
+    // Full carry, h < 2^130
+    c = h[1] >> 26; h[1] &= POLY1305_MASK; h[2] += c;
+    c = h[2] >> 26; h[2] &= POLY1305_MASK; h[3] += c;
+    c = h[3] >> 26; h[3] &= POLY1305_MASK; h[4] += c;
+    c = h[4] >> 26; h[4] &= POLY1305_MASK; h[0] += c * 5;
+    c = h[0] >> 26; h[0] &= POLY1305_MASK; h[1] += c;
+
+    // g = h - p, taken instead of h (without a branch) if h >= p
+    c = 5;
+    for (size_t i = 0; i < 5; i++) {
+        g[i] = h[i] + c;
+        c = g[i] >> 26;
+        g[i] &= POLY1305_MASK;
+    }
+    g[4] = (g[4] | c << 26) - (1 << 26);
+
+    uint32_t mask = (g[4] >> 31) - 1;
+    for (size_t i = 0; i < 5; i++) {
+        h[i] = (h[i] & ~mask) | (g[i] & mask);
+    }
+
+    // h + s mod 2^128 in 32 bit words
+    uint32_t w[4] = {
+        h[0] | h[1] << 26,
+        h[1] >> 6 | h[2] << 20,
+        h[2] >> 12 | h[3] << 14,
+        h[3] >> 18 | h[4] << 8
+    };
+    uint64_t f = 0;
+    for (size_t i = 0; i < 4; i++) {
+        f = (uint64_t) w[i] + ctx->pad[i] + (f >> 32);
+        w[i] = f;
+    }
+    memcpy(tag, w, POLY1305_TAG_SIZE);
+
+    explicit_bzero(ctx, sizeof(*ctx));
+    explicit_bzero(g, sizeof(g));
+}
+
+// Tag of the complete message in one call
+void poly1305(uint8_t tag[POLY1305_TAG_SIZE], const uint8_t* msg, size_t len, const uint8_t key[POLY1305_KEY_SIZE]) {
+    struct poly1305_ctx ctx;
+    poly1305_init(&ctx, key);
+    poly1305_update(&ctx, msg, len);
+    poly1305_final(&ctx, tag);
+}
+
+// Compares two tags in constant time, 0 if they are equal and -1 otherwise
+int poly1305_verify(const uint8_t a[POLY1305_TAG_SIZE], const uint8_t b[POLY1305_TAG_SIZE]) {
+    uint32_t diff = 0;
+
+    for (size_t i = 0; i < POLY1305_TAG_SIZE; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return (int) ((diff - 1) >> 8 & 1) - 1;
+}
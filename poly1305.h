@@ -0,0 +1,37 @@
+#ifndef SALSA20_POLY1305_H
+#define SALSA20_POLY1305_H
+
+#include <aio.h>
+#include <stdint.h>
+
+#define POLY1305_KEY_SIZE 32
+#define POLY1305_TAG_SIZE 16
+#define POLY1305_BLOCK_SIZE 16
+
+/*  State of an incremental Poly1305 computation. The accumulator h and the powers of r
+*   are kept in radix 2^26 (five limbs of 26 bits), so that every product of two limbs
+*   fits the 32x32 -> 64 bit multiplications of SSE2 and AVX2. simd_width is the
+*   number of blocks the vectorized code processes in parallel (0: scalar only).
+*/
+struct poly1305_ctx {
+    uint32_t r[4][5];       // r, r^2, r^3, r^4
+    uint32_t h[5];
+    uint32_t pad[4];
+    uint8_t buf[POLY1305_BLOCK_SIZE];
+    size_t buflen;
+    size_t simd_width;
+};
+
+void poly1305_init(struct poly1305_ctx* ctx, const uint8_t key[POLY1305_KEY_SIZE]);
+
+void poly1305_init_features(struct poly1305_ctx* ctx, const uint8_t key[POLY1305_KEY_SIZE], uint32_t features);
+
+void poly1305_update(struct poly1305_ctx* ctx, const uint8_t* msg, size_t len);
+
+void poly1305_final(struct poly1305_ctx* ctx, uint8_t tag[POLY1305_TAG_SIZE]);
+
+void poly1305(uint8_t tag[POLY1305_TAG_SIZE], const uint8_t* msg, size_t len, const uint8_t key[POLY1305_KEY_SIZE]);
+
+int poly1305_verify(const uint8_t a[POLY1305_TAG_SIZE], const uint8_t b[POLY1305_TAG_SIZE]);
+
+#endif  // SALSA20_POLY1305_H
@@ -0,0 +1,191 @@
+#include <aio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <emmintrin.h>
+
+#include "core_v3.h"
+#include "sha256.h"
+#include "threadpool.h"
+#include "scrypt.h"
+
+/*  scrypt (RFC 7914). The work is done by ROMix on p independent lanes of 128 * r
+*   bytes. ROMix keeps every 64 byte block of its state and of the table V in the
+*   diagonal layout of rotate_simd, four __m128i rows per block (see salsa20_core_v3).
+*   The layout is only converted when a lane is loaded and stored, the N
+*   BlockMix calls in between run the Salsa20/8 rounds of salsa20_core_v3_diag
+*   directly on it: the xor's, the feed forward and the copies to and from V work
+*   on the rows just as well, and the word Integerify needs is in lane 0 of the
+*   first row.
+*/
+
+// Converts a 64 byte block to the diagonal layout: row k, lane i holds word (4 * k + 5 * i) % 16
+static inline void scrypt_load_block(__m128i rows[4], const uint8_t block[64]) {
+    uint32_t w[16];
+    memcpy(w, block, sizeof(w));
+
+    for (size_t k = 0; k < 4; k++) {
+        rows[k] = _mm_setr_epi32(w[(4 * k) % 16], w[(4 * k + 5) % 16], w[(4 * k + 10) % 16], w[(4 * k + 15) % 16]);
+    }
+}
+
+static inline void scrypt_store_block(uint8_t block[64], const __m128i rows[4]) {
+    uint32_t d[4][4];
+    uint32_t w[16];
+
+    for (size_t k = 0; k < 4; k++) {
+        _mm_storeu_si128((__m128i_u*) d[k], rows[k]);
+        for (size_t i = 0; i < 4; i++) {
+            w[(4 * k + 5 * i) % 16] = d[k][i];
+        }
+    }
+    memcpy(block, w, sizeof(w));
+}
+
+/*  BlockMix with Salsa20/8 on the 2 * r blocks of in (xor'ed with the blocks of
+*   in2 first if given): X starts as the last block, every block is xor'ed into X,
+*   which then goes through Salsa20/8. The results of the even blocks are written to
+*   the first half of out, those of the odd blocks to the second half.
+*/
+static inline __attribute__((always_inline)) void scrypt_blockmix(__m128i* out, const __m128i* in, const __m128i* in2, size_t r) {
+    __m128i x[4];
+
+    for (size_t k = 0; k < 4; k++) {
+        x[k] = in[4 * (2 * r - 1) + k];
+        if (in2) {
+            x[k] = _mm_xor_si128(x[k], in2[4 * (2 * r - 1) + k]);
+        }
+    }
+
+    for (size_t i = 0; i < 2 * r; i++) {
+        __m128i t[4];
+
+        for (size_t k = 0; k < 4; k++) {
+            x[k] = _mm_xor_si128(x[k], in[4 * i + k]);
+            if (in2) {
+                x[k] = _mm_xor_si128(x[k], in2[4 * i + k]);
+            }
+            t[k] = x[k];
+        }
+
+        salsa20_core_v3_diag(x, 8);
+
+        __m128i* y = out + 4 * (i / 2 + (i % 2) * r);
+        for (size_t k = 0; k < 4; k++) {
+            x[k] = _mm_add_epi32(x[k], t[k]);
+            y[k] = x[k];
+        }
+    }
+}
+
+/*  ROMix on one lane b of 128 * r bytes. v has room for N states, x and y for
+*   one each. N has to be a power of two.
+*/
+static void scrypt_romix(uint8_t* b, size_t r, uint64_t N, __m128i* v, __m128i* x, __m128i* y) {
+    size_t words = 8 * r;   // __m128i's per state
+
+    for (size_t i = 0; i < 2 * r; i++) {
+        scrypt_load_block(x + 4 * i, b + 64 * i);
+    }
+
+    for (uint64_t i = 0; i < N; i += 2) {
+        memcpy(v + i * words, x, words * sizeof(__m128i));
+        scrypt_blockmix(y, x, NULL, r);
+        memcpy(v + (i + 1) * words, y, words * sizeof(__m128i));
+        scrypt_blockmix(x, y, NULL, r);
+    }
+
+    // Integerify: word 0 of the last block, which is lane 0 of its first row
+    for (uint64_t i = 0; i < N; i += 2) {
+        uint64_t j = (uint32_t) _mm_cvtsi128_si32(x[words - 4]) & (N - 1);
+        scrypt_blockmix(y, x, v + j * words, r);
+
+        j = (uint32_t) _mm_cvtsi128_si32(y[words - 4]) & (N - 1);
+        scrypt_blockmix(x, y, v + j * words, r);
+    }
+
+    for (size_t i = 0; i < 2 * r; i++) {
+        scrypt_store_block(b + 64 * i, x + 4 * i);
+    }
+}
+
+struct scrypt_job {
+    uint8_t* b;
+    size_t r;
+    uint64_t N;
+    int failed;
+};
+
+// Task of the thread pool: ROMix on lane index, with a table V of its own
+static void scrypt_lane(void* arg, size_t index) {
+    struct scrypt_job* job = arg;
+    size_t words = 8 * job->r;
+    __m128i* v = aligned_alloc(64, (job->N + 2) * words * sizeof(__m128i));
+
+    if (!v) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    scrypt_romix(job->b + 128 * job->r * index, job->r, job->N, v, v + job->N * words, v + (job->N + 1) * words);
+
+    // V, X and Y are derived from the password
+    explicit_bzero(v, (job->N + 2) * words * sizeof(__m128i));
+    free(v);
+}
+
+/*
+*   Derives outlen bytes from the password and the salt with scrypt(N, r, p):
+*   B = PBKDF2-HMAC-SHA256(passwd, salt, 1, p * 128 * r), ROMix on each of the p lanes
+*   of B and out = PBKDF2-HMAC-SHA256(passwd, B, 1, outlen). The lanes run on a pool of
+*   nthreads threads (0: one per lane), each of them needs 128 * r * N bytes of memory.
+*   N has to be a power of two greater than 1 and below 2^32. Returns EXIT_SUCCESS or
+*   EXIT_FAILURE.
+*/
+int scrypt(const uint8_t* passwd, size_t passwdlen, const uint8_t* salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p, size_t nthreads, uint8_t* out, size_t outlen) {
+    if (N < 2 || N > UINT32_MAX || (N & (N - 1)) || r == 0 || p == 0) {
+        fprintf(stderr, "scrypt: N has to be a power of two between 2 and 2^31, r and p have to be positive\n");
+        return EXIT_FAILURE;
+    } else if ((uint64_t) r * p >= (1 << 30) || N + 2 > SIZE_MAX / 128 / r) {
+        fprintf(stderr, "scrypt: N = %lu, r = %u and p = %u exceed the limits of the memory\n", N, r, p);
+        return EXIT_FAILURE;
+    }
+
+    size_t lane_size = 128 * (size_t) r;
+    struct scrypt_job job = { .r = r, .N = N, .failed = 0 };
+
+    if (!(job.b = aligned_alloc(64, lane_size * p))) {
+        fprintf(stderr, "scrypt: could not allocate %lu bytes\n", lane_size * p);
+        return EXIT_FAILURE;
+    }
+
+    pbkdf2_sha256(passwd, passwdlen, salt, saltlen, 1, job.b, lane_size * p);
+
+    if (!nthreads || nthreads > p) {
+        nthreads = p;
+    }
+
+    struct threadpool* pool = threadpool_create(nthreads);
+    if (!pool) {
+        fprintf(stderr, "scrypt: could not create %lu threads\n", nthreads);
+        explicit_bzero(job.b, lane_size * p);
+        free(job.b);
+        return EXIT_FAILURE;
+    }
+    threadpool_run(pool, scrypt_lane, &job, p);
+    threadpool_destroy(pool);
+
+    if (job.failed) {
+        fprintf(stderr, "scrypt: could not allocate %lu bytes for V\n", (N + 2) * lane_size);
+        explicit_bzero(job.b, lane_size * p);
+        free(job.b);
+        return EXIT_FAILURE;
+    }
+
+    pbkdf2_sha256(passwd, passwdlen, job.b, lane_size * p, 1, out, outlen);
+
+    explicit_bzero(job.b, lane_size * p);
+    free(job.b);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef SALSA20_SCRYPT_H
+#define SALSA20_SCRYPT_H
+
+#include <aio.h>
+#include <stdint.h>
+
+int scrypt(const uint8_t* passwd, size_t passwdlen, const uint8_t* salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p, size_t nthreads, uint8_t* out, size_t outlen);
+
+#endif  // SALSA20_SCRYPT_H
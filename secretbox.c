@@ -0,0 +1,92 @@
+#include <aio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dispatch.h"
+#include "poly1305.h"
+#include "xsalsa20.h"
+#include "secretbox.h"
+
+/*  XSalsa20-Poly1305 as crypto_secretbox of NaCl: the first 32 bytes of the XSalsa20
+*   key stream are the Poly1305 key, the message is encrypted with the key stream from
+*   byte 32 on and the tag authenticates the cipher text.
+*
+*   Both directions make a single pass over the message: it is en-/decrypted in tiles
+*   of SECRETBOX_TILE bytes, and the cipher text of a tile goes through Poly1305 while
+*   it is still in L1, instead of reading all of it from memory a second time. The
+*   tiles end at key stream block boundaries, so no block is generated twice, and they
+*   are far below the threshold of the non-temporal stores (see crypt_nt.c), which
+*   would move the cipher text out of the cache.
+*/
+
+// Bytes of key stream per tile: message and cipher text of a tile together take 32 KiB of L1
+#define SECRETBOX_TILE 16384
+
+// Subkey, iv and the Poly1305 context for the key and nonce
+static void secretbox_setup(const struct salsa20_impl* impl, uint32_t subkey[8], uint64_t* iv, struct poly1305_ctx* mac, const uint32_t key[8], const uint8_t nonce[SECRETBOX_NONCE_SIZE]) {
+    uint8_t mac_key[POLY1305_KEY_SIZE] = { 0 };
+
+    xsalsa20_subkey(subkey, key, nonce);
+    memcpy(iv, nonce + 16, sizeof(*iv));
+
+    impl->crypt(sizeof(mac_key), mac_key, mac_key, subkey, *iv, 0, impl->core);
+    poly1305_init(mac, mac_key);
+    explicit_bzero(mac_key, sizeof(mac_key));
+}
+
+// Length of the tile at position pos of the message (key stream byte 32 + pos)
+static inline size_t secretbox_tile(size_t pos, size_t mlen) {
+    size_t n = SECRETBOX_TILE - (32 + pos) % SECRETBOX_TILE;
+    return n < mlen - pos ? n : mlen - pos;
+}
+
+/*  Encrypts mlen bytes of msg into cipher (msg == cipher is allowed) and writes the
+*   tag. The nonce must never be used twice with the same key.
+*/
+void secretbox_seal(uint8_t tag[SECRETBOX_TAG_SIZE], uint8_t* cipher, const uint8_t* msg, size_t mlen, const uint8_t nonce[SECRETBOX_NONCE_SIZE], const uint32_t key[8]) {
+    const struct salsa20_impl* impl = salsa20_dispatch();
+    struct poly1305_ctx mac;
+    uint32_t subkey[8];
+    uint64_t iv;
+
+    secretbox_setup(impl, subkey, &iv, &mac, key, nonce);
+
+    for (size_t pos = 0, n; pos < mlen; pos += n) {
+        n = secretbox_tile(pos, mlen);
+        impl->crypt(n, msg + pos, cipher + pos, subkey, iv, 32 + pos, impl->core);
+        poly1305_update(&mac, cipher + pos, n);
+    }
+    poly1305_final(&mac, tag);
+
+    explicit_bzero(subkey, sizeof(subkey));
+}
+
+/*  Decrypts clen bytes of cipher into msg (cipher == msg is allowed) if the tag is
+*   correct and returns 0. Otherwise msg is wiped and -1 is returned: since every tile
+*   is authenticated and decrypted in the same pass, msg must not be used before the
+*   return value was checked.
+*/
+int secretbox_open(uint8_t* msg, const uint8_t* cipher, size_t clen, const uint8_t tag[SECRETBOX_TAG_SIZE], const uint8_t nonce[SECRETBOX_NONCE_SIZE], const uint32_t key[8]) {
+    const struct salsa20_impl* impl = salsa20_dispatch();
+    struct poly1305_ctx mac;
+    uint8_t expected[SECRETBOX_TAG_SIZE];
+    uint32_t subkey[8];
+    uint64_t iv;
+
+    secretbox_setup(impl, subkey, &iv, &mac, key, nonce);
+
+    for (size_t pos = 0, n; pos < clen; pos += n) {
+        n = secretbox_tile(pos, clen);
+        poly1305_update(&mac, cipher + pos, n);
+        impl->crypt(n, cipher + pos, msg + pos, subkey, iv, 32 + pos, impl->core);
+    }
+    poly1305_final(&mac, expected);
+
+    explicit_bzero(subkey, sizeof(subkey));
+
+    if (poly1305_verify(expected, tag)) {
+        explicit_bzero(msg, clen);
+        return -1;
+    }
+    return 0;
+}
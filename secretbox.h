@@ -0,0 +1,14 @@
+#ifndef SALSA20_SECRETBOX_H
+#define SALSA20_SECRETBOX_H
+
+#include <aio.h>
+#include <stdint.h>
+
+#define SECRETBOX_NONCE_SIZE 24
+#define SECRETBOX_TAG_SIZE 16
+
+void secretbox_seal(uint8_t tag[SECRETBOX_TAG_SIZE], uint8_t* cipher, const uint8_t* msg, size_t mlen, const uint8_t nonce[SECRETBOX_NONCE_SIZE], const uint32_t key[8]);
+
+int secretbox_open(uint8_t* msg, const uint8_t* cipher, size_t clen, const uint8_t tag[SECRETBOX_TAG_SIZE], const uint8_t nonce[SECRETBOX_NONCE_SIZE], const uint32_t key[8]);
+
+#endif  // SALSA20_SECRETBOX_H
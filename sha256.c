@@ -0,0 +1,193 @@
+#include <aio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sha256.h"
+
+/*  SHA-256 (FIPS 180-4), HMAC-SHA256 (RFC 2104) and PBKDF2-HMAC-SHA256 (RFC 8018),
+*   only as far as scrypt needs them. scrypt spends almost all of its time in ROMix,
+*   so this is a plain portable implementation.
+*/
+
+#define ROTR(a, b) (((a) >> (b)) | ((a) << (32 - (b))))
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void sha256_block(uint32_t h[8], const uint8_t block[SHA256_BLOCK_SIZE]) {
+    uint32_t w[64];
+
+    for (size_t i = 0; i < 16; i++) {
+        w[i] = (uint32_t) block[4 * i] << 24 | (uint32_t) block[4 * i + 1] << 16 | (uint32_t) block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+    for (size_t i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+
+    for (size_t i = 0; i < 64; i++) {
+        uint32_t t1 = k + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += k;
+}
+
+void sha256_init(struct sha256_ctx* ctx) {
+    static const uint32_t h0[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    memcpy(ctx->h, h0, sizeof(h0));
+    ctx->len = 0;
+}
+
+void sha256_update(struct sha256_ctx* ctx, const uint8_t* data, size_t len) {
+    size_t used = ctx->len % SHA256_BLOCK_SIZE;
+    ctx->len += len;
+
+    // Fill up a partial block from a previous update first
+    if (used) {
+        size_t n = SHA256_BLOCK_SIZE - used < len ? SHA256_BLOCK_SIZE - used : len;
+        memcpy(ctx->buf + used, data, n);
+        data += n;
+        len -= n;
+        if (used + n < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        sha256_block(ctx->h, ctx->buf);
+    }
+
+    for (; len >= SHA256_BLOCK_SIZE; data += SHA256_BLOCK_SIZE, len -= SHA256_BLOCK_SIZE) {
+        sha256_block(ctx->h, data);
+    }
+    memcpy(ctx->buf, data, len);
+}
+
+void sha256_final(struct sha256_ctx* ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint64_t bits = ctx->len * 8;
+    uint8_t pad[SHA256_BLOCK_SIZE + 8] = { 0x80 };
+    size_t used = ctx->len % SHA256_BLOCK_SIZE;
+    size_t padlen = (used < 56 ? 56 : 120) - used;
+
+    for (size_t i = 0; i < 8; i++) {
+        pad[padlen + i] = bits >> (56 - 8 * i);
+    }
+    sha256_update(ctx, pad, padlen + 8);
+
+    for (size_t i = 0; i < 8; i++) {
+        digest[4 * i] = ctx->h[i] >> 24;
+        digest[4 * i + 1] = ctx->h[i] >> 16;
+        digest[4 * i + 2] = ctx->h[i] >> 8;
+        digest[4 * i + 3] = ctx->h[i];
+    }
+}
+
+/*  HMAC state after the inner and outer padded key: every HMAC with the same key
+*   continues from a copy of these two contexts instead of hashing the key again.
+*/
+struct hmac_sha256_ctx {
+    struct sha256_ctx inner;
+    struct sha256_ctx outer;
+};
+
+static void hmac_sha256_init(struct hmac_sha256_ctx* ctx, const uint8_t* key, size_t keylen) {
+    uint8_t k[SHA256_BLOCK_SIZE] = { 0 };
+    uint8_t pad[SHA256_BLOCK_SIZE];
+
+    // Keys longer than a block are replaced by their hash
+    if (keylen > SHA256_BLOCK_SIZE) {
+        struct sha256_ctx key_ctx;
+        sha256_init(&key_ctx);
+        sha256_update(&key_ctx, key, keylen);
+        sha256_final(&key_ctx, k);
+    } else {
+        memcpy(k, key, keylen);
+    }
+
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = k[i] ^ 0x36;
+    }
+    sha256_init(&ctx->inner);
+    sha256_update(&ctx->inner, pad, SHA256_BLOCK_SIZE);
+
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = k[i] ^ 0x5c;
+    }
+    sha256_init(&ctx->outer);
+    sha256_update(&ctx->outer, pad, SHA256_BLOCK_SIZE);
+}
+
+// Finishes an HMAC whose message was hashed into inner (a copy of ctx->inner)
+static void hmac_sha256_final(const struct hmac_sha256_ctx* ctx, struct sha256_ctx* inner, uint8_t mac[SHA256_DIGEST_SIZE]) {
+    struct sha256_ctx outer = ctx->outer;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+
+    sha256_final(inner, digest);
+    sha256_update(&outer, digest, SHA256_DIGEST_SIZE);
+    sha256_final(&outer, mac);
+}
+
+/*  PBKDF2 with HMAC-SHA256 as pseudo random function: block i of the output is
+*   U_1 ^ ... ^ U_iterations with U_1 = HMAC(passwd, salt || INT(i)) and
+*   U_j = HMAC(passwd, U_(j-1)). outlen may be any number of bytes.
+*/
+void pbkdf2_sha256(const uint8_t* passwd, size_t passwdlen, const uint8_t* salt, size_t saltlen, uint64_t iterations, uint8_t* out, size_t outlen) {
+    struct hmac_sha256_ctx hmac;
+    hmac_sha256_init(&hmac, passwd, passwdlen);
+
+    // The salt is the same for every block, so it is hashed only once
+    struct sha256_ctx salted = hmac.inner;
+    sha256_update(&salted, salt, saltlen);
+
+    for (uint32_t i = 1; outlen; i++) {
+        uint8_t index[4] = { i >> 24, i >> 16, i >> 8, i };
+        uint8_t u[SHA256_DIGEST_SIZE];
+        uint8_t t[SHA256_DIGEST_SIZE];
+        struct sha256_ctx inner = salted;
+
+        sha256_update(&inner, index, sizeof(index));
+        hmac_sha256_final(&hmac, &inner, u);
+        memcpy(t, u, SHA256_DIGEST_SIZE);
+
+        for (uint64_t j = 1; j < iterations; j++) {
+            inner = hmac.inner;
+            sha256_update(&inner, u, SHA256_DIGEST_SIZE);
+            hmac_sha256_final(&hmac, &inner, u);
+            for (size_t k = 0; k < SHA256_DIGEST_SIZE; k++) {
+                t[k] ^= u[k];
+            }
+        }
+
+        size_t n = outlen < SHA256_DIGEST_SIZE ? outlen : SHA256_DIGEST_SIZE;
+        memcpy(out, t, n);
+        out += n;
+        outlen -= n;
+    }
+}
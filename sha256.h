@@ -0,0 +1,24 @@
+#ifndef SALSA20_SHA256_H
+#define SALSA20_SHA256_H
+
+#include <aio.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+struct sha256_ctx {
+    uint32_t h[8];
+    uint64_t len;       // number of bytes hashed so far
+    uint8_t buf[SHA256_BLOCK_SIZE];
+};
+
+void sha256_init(struct sha256_ctx* ctx);
+
+void sha256_update(struct sha256_ctx* ctx, const uint8_t* data, size_t len);
+
+void sha256_final(struct sha256_ctx* ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+void pbkdf2_sha256(const uint8_t* passwd, size_t passwdlen, const uint8_t* salt, size_t saltlen, uint64_t iterations, uint8_t* out, size_t outlen);
+
+#endif  // SALSA20_SHA256_H
@@ -0,0 +1,157 @@
+#include <aio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "core_x4.h"
+#include "core_x8.h"
+#include "core_x16.h"
+#include "dispatch.h"
+#include "stream.h"
+
+/*  Initializes the context for the given key and iv. The key stream starts at
+*   offset 0 and the fastest implementation supported by the CPU is used.
+*/
+void salsa20_init(struct salsa20_ctx* ctx, const uint32_t key[8], uint64_t iv) {
+    const struct salsa20_impl* impl = salsa20_dispatch();
+
+    memcpy(ctx->key, key, sizeof(ctx->key));
+    ctx->iv = iv;
+    ctx->offset = 0;
+    ctx->crypt = impl->crypt;
+    ctx->core = impl->core;
+
+    /*  The multi-block cores write whole blocks of key stream in the order of the stream,
+    *   with unaligned stores only (storeu), so their output may be at any address.
+    */
+    if ((cpu_features() & CPU_FEATURE_AVX512F)) {
+        ctx->wide_core = salsa20_core_x16;
+        ctx->wide_blocks = 16;
+    } else if (cpu_features() & CPU_FEATURE_AVX2) {
+        ctx->wide_core = salsa20_core_x8;
+        ctx->wide_blocks = 8;
+    } else {
+        ctx->wide_core = salsa20_core_x4;
+        ctx->wide_blocks = 4;
+    }
+}
+
+// Input matrix of the block with the given counter
+static void salsa20_input(const struct salsa20_ctx* ctx, uint64_t counter, uint32_t input[16]) {
+    uint32_t diag[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+    const uint32_t* key = ctx->key;
+
+    input[0] = diag[0];
+    input[1] = key[0];
+    input[2] = key[1];
+    input[3] = key[2];
+    input[4] = key[3];
+    input[5] = diag[1];
+    input[6] = ctx->iv & 0xffffffff;
+    input[7] = ctx->iv >> 32;
+    input[8] = counter & 0xffffffff;
+    input[9] = counter >> 32;
+    input[10] = diag[2];
+    input[11] = key[4];
+    input[12] = key[5];
+    input[13] = key[6];
+    input[14] = key[7];
+    input[15] = diag[3];
+}
+
+// Generates the key stream block with the given counter into ctx->key_stream
+static void salsa20_refill(struct salsa20_ctx* ctx, uint64_t counter) {
+    uint32_t input[16];
+
+    salsa20_input(ctx, counter, input);
+    ctx->core(ctx->key_stream, input);
+}
+
+/*  En-/decrypts the next len bytes of the stream. Calling this function several times
+*   yields the same result as a single call with the concatenated input, and costs the
+*   same number of core invocations: the leftover bytes of a partial block are buffered
+*   in the context and used first by the next call. Whole blocks are passed on to the
+*   crypt implementation. in and out may be the same buffer.
+*/
+void salsa20_update(struct salsa20_ctx* ctx, const uint8_t* in, uint8_t* out, size_t len) {
+    uint8_t* key_byte_stream = (uint8_t*) ctx->key_stream;
+    size_t n = 0;
+
+    // Use up the buffered block first
+    while (n < len && ctx->offset % 64) {
+        out[n] = in[n] ^ key_byte_stream[ctx->offset % 64];
+        ctx->offset++;
+        n++;
+    }
+
+    // Whole blocks, the offset is now a multiple of 64
+    size_t bulk = (len - n) & ~(size_t) 63;
+    if (bulk) {
+        ctx->crypt(bulk, in + n, out + n, ctx->key, ctx->iv, ctx->offset, ctx->core);
+        ctx->offset += bulk;
+        n += bulk;
+    }
+
+    // Last partial block: keep the key stream for the next call
+    if (n < len) {
+        salsa20_refill(ctx, ctx->offset / 64);
+
+        while (n < len) {
+            out[n] = in[n] ^ key_byte_stream[ctx->offset % 64];
+            ctx->offset++;
+            n++;
+        }
+    }
+}
+
+/*  Writes the next len bytes of the key stream itself to out (as if a message of zeros
+*   was encrypted), e.g. as a source of random bytes. Like salsa20_update the calls
+*   can be split arbitrarily. Groups of whole blocks are generated by the widest
+*   multi-block core directly into out, without going through the crypt.
+*/
+void salsa20_keystream(struct salsa20_ctx* ctx, uint8_t* out, size_t len) {
+    uint8_t* key_byte_stream = (uint8_t*) ctx->key_stream;
+    uint32_t input[16];
+    size_t n = 0;
+
+    // Use up the buffered block first
+    while (n < len && ctx->offset % 64) {
+        out[n] = key_byte_stream[ctx->offset % 64];
+        ctx->offset++;
+        n++;
+    }
+
+    // The wide core writes with unaligned stores, out + n needs no alignment (see salsa20_init)
+    size_t wide = ctx->wide_blocks * 64;
+    while (len - n >= wide) {
+        salsa20_input(ctx, ctx->offset / 64, input);
+        ctx->wide_core((uint32_t*) (out + n), input);
+        ctx->offset += wide;
+        n += wide;
+    }
+
+    /*  Single blocks go through key_stream: the dispatched core may be a scalar one that
+    *   stores uint32_t's, which needs an aligned output.
+    */
+    while (len - n >= 64) {
+        salsa20_refill(ctx, ctx->offset / 64);
+        memcpy(out + n, key_byte_stream, 64);
+        ctx->offset += 64;
+        n += 64;
+    }
+
+    // Last partial block: keep the key stream for the next call
+    if (n < len) {
+        salsa20_refill(ctx, ctx->offset / 64);
+
+        while (n < len) {
+            out[n] = key_byte_stream[ctx->offset % 64];
+            ctx->offset++;
+            n++;
+        }
+    }
+}
+
+// Ends the stream and wipes the key and the buffered key stream from the context
+void salsa20_final(struct salsa20_ctx* ctx) {
+    explicit_bzero(ctx, sizeof(*ctx));
+}
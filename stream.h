@@ -0,0 +1,34 @@
+#ifndef SALSA20_STREAM_H
+#define SALSA20_STREAM_H
+
+#include <aio.h>
+#include <stdint.h>
+
+#include "dispatch.h"
+
+/*  Context for incremental en-/decryption. offset is the position of the next key
+*   stream byte. If it is not a multiple of 64, key_stream holds the block that
+*   contains it, so the unused bytes of a partial block carry over to the next call.
+*   wide_core is the widest multi-block core of the CPU and generates wide_blocks
+*   consecutive blocks per call (salsa20_keystream).
+*/
+struct salsa20_ctx {
+    uint32_t key[8];
+    uint64_t iv;
+    uint64_t offset;
+    uint32_t key_stream[16];
+    crypt_func crypt;
+    core_func core;
+    core_func wide_core;
+    size_t wide_blocks;
+};
+
+void salsa20_init(struct salsa20_ctx* ctx, const uint32_t key[8], uint64_t iv);
+
+void salsa20_update(struct salsa20_ctx* ctx, const uint8_t* in, uint8_t* out, size_t len);
+
+void salsa20_keystream(struct salsa20_ctx* ctx, uint8_t* out, size_t len);
+
+void salsa20_final(struct salsa20_ctx* ctx);
+
+#endif  // SALSA20_STREAM_H
@@ -0,0 +1,152 @@
+#include <aio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "threadpool.h"
+
+/*  Persistent pool of worker threads. The threads are created once and wait for
+*   batches of tasks (threadpool_run). A batch consists of ntasks calls of the same
+*   function with the indices 0 to ntasks - 1, which are handed out to the workers
+*   and the calling thread in order. generation is incremented for every batch so
+*   that the workers can tell a new batch from a spurious wakeup.
+*/
+struct threadpool {
+    pthread_t* threads;
+    size_t nworkers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    task_func task;
+    void* arg;
+    size_t ntasks;
+    size_t next_task;
+    size_t done_tasks;
+    uint64_t generation;
+    int stop;
+};
+
+// Runs tasks of the current batch until none are left. Has to be called with the lock held.
+static void threadpool_work(struct threadpool* pool) {
+    while (pool->next_task < pool->ntasks) {
+        size_t index = pool->next_task++;
+        task_func task = pool->task;
+        void* arg = pool->arg;
+
+        pthread_mutex_unlock(&pool->lock);
+        task(arg, index);
+        pthread_mutex_lock(&pool->lock);
+
+        if (++pool->done_tasks == pool->ntasks) {
+            pthread_cond_signal(&pool->done_cond);
+        }
+    }
+}
+
+static void* threadpool_worker(void* data) {
+    struct threadpool* pool = data;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->stop && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        }
+
+        if (pool->stop) {
+            break;
+        }
+
+        seen = pool->generation;
+        threadpool_work(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/*  Creates a pool that runs tasks on nthreads threads: nthreads - 1 workers and the
+*   thread that calls threadpool_run. Returns NULL on failure.
+*/
+struct threadpool* threadpool_create(size_t nthreads) {
+    struct threadpool* pool;
+
+    if (nthreads == 0 || !(pool = calloc(1, sizeof(struct threadpool)))) {
+        return NULL;
+    }
+
+    pool->nworkers = nthreads - 1;
+    if (pool->nworkers && !(pool->threads = calloc(pool->nworkers, sizeof(pthread_t)))) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (size_t i = 0; i < pool->nworkers; i++) {
+        if (pthread_create(&pool->threads[i], NULL, threadpool_worker, pool)) {
+            fprintf(stderr, "Could not create worker thread %lu\n", i);
+            pool->nworkers = i;
+            threadpool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+// Number of threads (including the calling thread) that execute tasks
+size_t threadpool_size(const struct threadpool* pool) {
+    return pool->nworkers + 1;
+}
+
+/*  Calls task(arg, i) for every i in [0, ntasks) on the threads of the pool and
+*   returns after all calls have finished.
+*/
+void threadpool_run(struct threadpool* pool, task_func task, void* arg, size_t ntasks) {
+    pthread_mutex_lock(&pool->lock);
+
+    pool->task = task;
+    pool->arg = arg;
+    pool->ntasks = ntasks;
+    pool->next_task = 0;
+    pool->done_tasks = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    // The calling thread works on the batch as well
+    threadpool_work(pool);
+
+    while (pool->done_tasks < pool->ntasks) {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Stops and joins all workers and frees the pool
+void threadpool_destroy(struct threadpool* pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->nworkers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,19 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <aio.h>
+#include <stdint.h>
+
+typedef void (*task_func)(void* arg, size_t index);
+
+struct threadpool;
+
+struct threadpool* threadpool_create(size_t nthreads);
+
+size_t threadpool_size(const struct threadpool* pool);
+
+void threadpool_run(struct threadpool* pool, task_func task, void* arg, size_t ntasks);
+
+void threadpool_destroy(struct threadpool* pool);
+
+#endif  // THREADPOOL_H
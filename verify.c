@@ -1,17 +1,46 @@
+// CPU affinity of the single CPU pipeline test
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "core_v0.h"
 #include "core_v1.h"
 #include "core_v2.h"
 #include "core_v3.h"
+#include "core_x4.h"
+#include "core_x8.h"
+#include "core_x16.h"
+#include "core_state.h"
 #include "crypt_v0.h"
 #include "crypt_v1.h"
+#include "crypt_v2.h"
+#include "crypt_v3.h"
+#include "crypt_v4.h"
+#include "crypt_v5.h"
+#include "crypt_v6.h"
+#include "crypt_parallel.h"
+#include "crypt_nt.h"
+#include "batch.h"
+#include "multibuf.h"
+#include "dispatch.h"
+#include "fileio.h"
+#include "pipeline.h"
+#include "stream.h"
+#include "drbg.h"
 #include "mtr_util.h"
+#include "sha256.h"
+#include "scrypt.h"
+#include "xsalsa20.h"
+#include "poly1305.h"
+#include "secretbox.h"
 #include "reference/ecrypt-sync.h"
 #include "reference/ecrypt.h"
 
@@ -61,11 +90,152 @@ int verify_core(){
     if (mtr_equal(out, verification_out)) {
         failed++;
     }
+    printf("\n");
+
+    /*  The multi-block core has to produce the same blocks as four calls of a single
+    *   block core with consecutive counters. The counter starts right below a 2^32
+    *   boundary to also check the carry into the high word.
+    */
+    printf("Comparing x4 \x1B[1;36m	(simd + word-sliced) \x1B[0m	and v2 blocks...\n");
+    uint32_t out_x4[64];
+    uint32_t in_x4[16];
+    memcpy(in_x4, verification_in, sizeof(in_x4));
+    in_x4[8] = 0xfffffffe;
+    salsa20_core_x4(out_x4, in_x4);
+    for (size_t j = 0; j < 4; j++) {
+        salsa20_core_v2(out, in_x4);
+        if (mtr_equal(out_x4 + 16 * j, out)) {
+            failed++;
+        }
+        in_x4[9] += (++in_x4[8] == 0);
+    }
+    printf("\n");
+
+    if (cpu_features() & CPU_FEATURE_AVX2) {
+        printf("Comparing x8 \x1B[1;36m	(avx2 + word-sliced) \x1B[0m	and v2 blocks...\n");
+        uint32_t out_x8[128];
+        memcpy(in_x4, verification_in, sizeof(in_x4));
+        in_x4[8] = 0xfffffffc;
+        salsa20_core_x8(out_x8, in_x4);
+        for (size_t j = 0; j < 8; j++) {
+            salsa20_core_v2(out, in_x4);
+            if (mtr_equal(out_x8 + 16 * j, out)) {
+                failed++;
+            }
+            in_x4[9] += (++in_x4[8] == 0);
+        }
+    } else {
+        printf("Skipping x8 \x1B[1;36m	(avx2 + word-sliced) \x1B[0m	the CPU does not support AVX2\n");
+    }
+    printf("\n");
+
+    if (cpu_features() & CPU_FEATURE_AVX512F) {
+        printf("Comparing x16 \x1B[1;36m	(avx-512 + word-sliced) \x1B[0m	and v2 blocks...\n");
+        uint32_t out_x16[256];
+        memcpy(in_x4, verification_in, sizeof(in_x4));
+        in_x4[8] = 0xfffffff8;
+        salsa20_core_x16(out_x16, in_x4);
+        for (size_t j = 0; j < 16; j++) {
+            salsa20_core_v2(out, in_x4);
+            if (mtr_equal(out_x16 + 16 * j, out)) {
+                failed++;
+            }
+            in_x4[9] += (++in_x4[8] == 0);
+        }
+    } else {
+        printf("Skipping x16 \x1B[1;36m	(avx-512 + word-sliced) \x1B[0m	the CPU does not support AVX-512F\n");
+    }
+    printf("\n");
+
+    /*  The state core works on the pre-rotated matrix and increments the counter itself.
+    *   Starting at counter 2^32 - 2, the third block checks the carry into the high word.
+    */
+    printf("Comparing state \x1B[1;36m	(simd + diagonal state) \x1B[0m	and v2 blocks...\n");
+    uint32_t key[8] = {
+        verification_in[1], verification_in[2], verification_in[3], verification_in[4],
+        verification_in[11], verification_in[12], verification_in[13], verification_in[14]
+    };
+    uint64_t iv = ((uint64_t) verification_in[7] << 32) | verification_in[6];
+    struct salsa20_state state;
+    salsa20_state_init(&state, key, iv, 0xfffffffe);
+
+    memcpy(in_x4, verification_in, sizeof(in_x4));
+    in_x4[8] = 0xfffffffe;
+    for (size_t j = 0; j < 3; j++) {
+        uint32_t out_state[16];
+        salsa20_core_state((uint8_t*) out_state, &state);
+        salsa20_core_v2(out, in_x4);
+        if (mtr_equal(out_state, out)) {
+            failed++;
+        }
+        in_x4[9] += (++in_x4[8] == 0);
+    }
     printf("\n\n");
 
     return failed;
 }
 
+/*  Encrypts a message of mlen bytes with the given implementation, starting at byte
+*   offset of the key stream, and compares the result with the reference implementation.
+*   A non trivial key and iv are used and the message is long enough to reach the
+*   multi-block paths of the crypt functions.
+*/
+static int verify_crypt_long(const char* name, crypt_func crypt, core_func core, size_t mlen, uint64_t offset) {
+    u8 k_8[32];
+    uint32_t k_32[8];
+    u8 iv_8[8];
+    uint64_t iv = 0;
+
+    for (size_t i = 0; i < 32; i++) {
+        k_8[i] = i * 7 + 1;
+    }
+    for (size_t i = 0; i < 8; i++) {
+        k_32[i] = U8TO32_LITTLE(k_8 + 4 * i);
+        iv_8[i] = 0xa0 + i;
+        iv |= (uint64_t) iv_8[i] << (8 * i);
+    }
+
+    // The reference implementation always starts at offset 0, so it encrypts offset + mlen bytes
+    size_t total = offset + mlen;
+    uint8_t* msg = malloc(total);
+    uint8_t* expected = malloc(total);
+    uint8_t* actual = malloc(mlen);
+    if (!msg || !expected || !actual) {
+        fprintf(stderr, "Could not allocate enough memory for the verification of %s\n", name);
+        free(msg);
+        free(expected);
+        free(actual);
+        return 1;
+    }
+
+    for (size_t i = 0; i < total; i++) {
+        msg[i] = i * 31 + 5;
+    }
+
+    ECRYPT_ctx m;
+    ECRYPT_keysetup(&m, k_8, 256, 0);
+    ECRYPT_ivsetup(&m, iv_8);
+    ECRYPT_encrypt_bytes(&m, msg, expected, total);
+
+    crypt(mlen, msg + offset, actual, k_32, iv, offset, core);
+
+    int failed = memcmp(expected + offset, actual, mlen) != 0;
+
+    // Every crypt implementation has to support msg == cipher
+    crypt(mlen, msg + offset, msg + offset, k_32, iv, offset, core);
+    failed |= memcmp(expected + offset, msg + offset, mlen) != 0;
+    if (!failed) {
+        printf("%s (%lu bytes at offset %lu) is\x1B[1;36m equivalent\x1B[0m to the reference implementation\n", name, mlen, offset);
+    } else {
+        printf("%s (%lu bytes at offset %lu) is\x1B[1;31m not equivalent\x1B[0m to the reference implementation!\n", name, mlen, offset);
+    }
+
+    free(msg);
+    free(expected);
+    free(actual);
+    return failed;
+}
+
 int verify_crypt(){
     int failed = 0;
     
@@ -103,7 +273,7 @@ int verify_crypt(){
 
     ECRYPT_encrypt_bytes(&m,(uint8_t*) mes, (uint8_t*) cip, len);
 
-    salsa20_crypt_v0(len, (uint8_t*) cip, (uint8_t*) mes, k_32, 0, salsa20_core_v0);
+    salsa20_crypt_v0(len, (uint8_t*) cip, (uint8_t*) mes, k_32, 0, 0, salsa20_core_v0);
 
     printf("Expected: %s\nActual:   %s\n", str, mes);
 
@@ -123,7 +293,7 @@ int verify_crypt(){
 
     ECRYPT_encrypt_bytes(&m,(uint8_t*) mes, (uint8_t*) ciph, len);
 
-    salsa20_crypt_v1(len, (uint8_t*) ciph, (uint8_t*) mes, k_32, 0, salsa20_core_v0);
+    salsa20_crypt_v1(len, (uint8_t*) ciph, (uint8_t*) mes, k_32, 0, 0, salsa20_core_v0);
 
     printf("Expected: %s\nActual: %s\n", str, mes);
 
@@ -133,6 +303,1206 @@ int verify_crypt(){
         printf("Actual and expected strings are\x1B[1;31m not equal\x1B[0m! (v1)\n");
         failed++;
     }
-    
+    printf("\n");
+
+    // 1000 bytes cover the bulk path of v1 (3 x 256 bytes) and a residual of 3 full and one partial block
+    if (verify_crypt_long("v1-crypt", salsa20_crypt_v1, salsa20_core_v3, 1000, 0)) {
+        failed++;
+    }
+
+    // 1500 bytes cover two iterations of the bulk path of v2 and a residual of 7 full and one partial block
+    if (cpu_features() & CPU_FEATURE_AVX2) {
+        if (verify_crypt_long("v2-crypt", salsa20_crypt_v2, salsa20_core_v3, 1500, 0)) {
+            failed++;
+        }
+    } else {
+        printf("Skipping v2-crypt, the CPU does not support AVX2\n");
+    }
+
+    // 2100 bytes cover two iterations of the bulk path of v3 and a residual of one partial block
+    if ((cpu_features() & CPU_FEATURE_AVX512F) && (cpu_features() & CPU_FEATURE_AVX512BW)) {
+        if (verify_crypt_long("v3-crypt", salsa20_crypt_v3, salsa20_core_v3, 2100, 0)) {
+            failed++;
+        }
+        if (verify_crypt_long("v3-crypt", salsa20_crypt_v3, salsa20_core_v3, 1343, 0)) {
+            failed++;
+        }
+    } else {
+        printf("Skipping v3-crypt, the CPU does not support AVX-512F/BW\n");
+    }
+
+    // 1000 bytes cover 15 fused blocks and one partial block of v4
+    if (verify_crypt_long("v4-crypt", salsa20_crypt_v4, NULL, 1000, 0)) {
+        failed++;
+    }
+
+    // 5000 bytes cover four whole tiles of v5/v6 and a last tile of 15 blocks, the last one partial
+    if (verify_crypt_long("v5-crypt", salsa20_crypt_v5, salsa20_core_v3, 5000, 0)) {
+        failed++;
+    }
+    if (cpu_features() & CPU_FEATURE_AVX2) {
+        if (verify_crypt_long("v6-crypt", salsa20_crypt_v6, salsa20_core_v3, 5000, 0)) {
+            failed++;
+        }
+    } else {
+        printf("Skipping v6-crypt, the CPU does not support AVX2\n");
+    }
+    printf("\n");
+
+    // Every version has to be able to start at an arbitrary byte offset of the key stream
+    uint64_t offsets[] = { 7, 64, 1000, 4099 };
+    const struct salsa20_impl* impl;
+    for (uint32_t version = 0; (impl = salsa20_get_impl(version)); version++) {
+        if (!salsa20_impl_supported(impl)) {
+            printf("Skipping %s, the CPU does not support it\n", impl->description);
+            continue;
+        }
+
+        for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+            if (verify_crypt_long(impl->description, impl->crypt, impl->core, 1100, offsets[i])) {
+                failed++;
+            }
+        }
+    }
+    printf("\n");
+
+    // Non-temporal stores for every message: the destination is aligned first and the offsets are not block aligned
+    salsa20_set_nt_threshold(1);
+    if (verify_crypt_long("v1-crypt (non-temporal)", salsa20_crypt_v1, salsa20_core_v3, 5000, 0)
+        || verify_crypt_long("v1-crypt (non-temporal)", salsa20_crypt_v1, salsa20_core_v3, 5003, 4099)
+        || verify_crypt_long("v5-crypt (non-temporal)", salsa20_crypt_v5, salsa20_core_v3, 3000, 37)) {
+        failed++;
+    }
+    if (cpu_features() & CPU_FEATURE_AVX2) {
+        if (verify_crypt_long("v2-crypt (non-temporal)", salsa20_crypt_v2, salsa20_core_v3, 5000, 0)
+            || verify_crypt_long("v2-crypt (non-temporal)", salsa20_crypt_v2, salsa20_core_v3, 5003, 4099)
+            || verify_crypt_long("v6-crypt (non-temporal)", salsa20_crypt_v6, salsa20_core_v3, 3000, 37)) {
+            failed++;
+        }
+    }
+    if ((cpu_features() & CPU_FEATURE_AVX512F) && (cpu_features() & CPU_FEATURE_AVX512BW)) {
+        if (verify_crypt_long("v3-crypt (non-temporal)", salsa20_crypt_v3, salsa20_core_v3, 5003, 4099)) {
+            failed++;
+        }
+    }
+    salsa20_set_nt_threshold(0);
+    printf("\n");
+
+    // Spans of the parallel crypt start at block boundaries of the key stream, also for odd offsets
+    if (salsa20_parallel_init(4, salsa20_crypt_v1)) {
+        printf("Could not create a thread pool for the parallel crypt\n");
+        failed++;
+    } else {
+        if (verify_crypt_long("parallel-crypt (4 threads)", salsa20_crypt_parallel, salsa20_core_v3, 1000003, 0)) {
+            failed++;
+        }
+        if (verify_crypt_long("parallel-crypt (4 threads)", salsa20_crypt_parallel, salsa20_core_v3, 300001, 37)) {
+            failed++;
+        }
+        salsa20_parallel_destroy();
+    }
+
+    return failed;
+}
+
+/*  The lanes of salsa20_core_x4_lanes/_x8_lanes each carry their own nonce and counter,
+*   so every lane is compared with the block of core_v2 for its input. The counters
+*   cross the boundary of the lower 32 bit word in some lanes.
+*/
+static int verify_core_lanes(const char* name, void (*lanes)(uint32_t[], const uint32_t[8], const uint64_t[], const uint64_t[]), size_t width) {
+    uint32_t key[8] = { 0x04030201, 0x08070605, 0x0c0b0a09, 0x100f0e0d, 0xc9c8c7c6, 0xcdcccbca, 0xd1d0cfce, 0xd5d4d3d2 };
+    uint64_t ivs[8];
+    uint64_t counters[8];
+    uint32_t output[128];
+    int failed = 0;
+
+    for (size_t j = 0; j < width; j++) {
+        ivs[j] = 0x0123456789abcdefull * (j + 1);
+        counters[j] = j % 2 ? 0xfffffffeull + j : j * 1000;
+    }
+
+    lanes(output, key, ivs, counters);
+
+    for (size_t j = 0; j < width; j++) {
+        uint32_t input[16] = {
+            0x61707865, key[0], key[1], key[2],
+            key[3], 0x3320646e, ivs[j] & 0xffffffff, ivs[j] >> 32,
+            counters[j] & 0xffffffff, counters[j] >> 32, 0x79622d32, key[4],
+            key[5], key[6], key[7], 0x6b206574
+        };
+        uint32_t expected[16];
+        salsa20_core_v2(expected, input);
+        failed |= memcmp(expected, output + 16 * j, sizeof(expected)) != 0;
+    }
+
+    if (!failed) {
+        printf("%s (%lu independent lanes) is\x1B[1;36m equivalent\x1B[0m to v2-core\n", name, width);
+    } else {
+        printf("%s (%lu independent lanes) is\x1B[1;31m not equivalent\x1B[0m to v2-core!\n", name, width);
+    }
+    return failed;
+}
+
+// Every lane of salsa20_core_x4_multi/_x8_multi has its own key, nonce and counter
+static int verify_core_multi(const char* name, void (*multi)(uint32_t[], const uint32_t[][16]), size_t width) {
+    uint32_t inputs[8][16];
+    uint32_t output[128];
+    int failed = 0;
+
+    for (size_t j = 0; j < width; j++) {
+        for (size_t i = 0; i < 16; i++) {
+            inputs[j][i] = 0x9e3779b9 * (16 * j + i + 1);
+        }
+    }
+
+    multi(output, (const uint32_t (*)[16]) inputs);
+
+    for (size_t j = 0; j < width; j++) {
+        uint32_t expected[16];
+        salsa20_core_v2(expected, inputs[j]);
+        failed |= memcmp(expected, output + 16 * j, sizeof(expected)) != 0;
+    }
+
+    if (!failed) {
+        printf("%s (%lu independent keys) is\x1B[1;36m equivalent\x1B[0m to v2-core\n", name, width);
+    } else {
+        printf("%s (%lu independent keys) is\x1B[1;31m not equivalent\x1B[0m to v2-core!\n", name, width);
+    }
+    return failed;
+}
+
+/*  Encrypts 21 streams with their own keys, nonces and offsets at once with
+*   salsa20_crypt_multi and compares every stream with the reference implementation.
+*   The lengths differ a lot, so lanes are refilled at different times.
+*/
+static int verify_crypt_multi(void) {
+    size_t lens[] = { 5000, 64, 1, 0, 700, 63, 65, 128, 3000, 17, 1000, 64, 200, 0, 4097, 333, 64, 1, 2048, 99, 640 };
+    size_t n = sizeof(lens) / sizeof(lens[0]);
+    struct salsa20_job jobs[sizeof(lens) / sizeof(lens[0])];
+    uint8_t* expected[sizeof(lens) / sizeof(lens[0])];
+    int failed = 0;
+
+    for (size_t m = 0; m < n; m++) {
+        u8 k_8[32];
+        u8 iv_8[8];
+        uint64_t offset = m % 3 ? 0 : 13 * m;
+        uint8_t* msg = malloc(offset + lens[m] + 1);
+        uint8_t* out = malloc(lens[m] + 1);
+        expected[m] = malloc(offset + lens[m] + 1);
+        if (!msg || !out || !expected[m]) {
+            fprintf(stderr, "Could not allocate enough memory for the verification of the multi-buffer crypt\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < 32; i++) {
+            k_8[i] = m * 32 + i;
+        }
+        jobs[m].iv = 0;
+        for (size_t i = 0; i < 8; i++) {
+            jobs[m].key[i] = U8TO32_LITTLE(k_8 + 4 * i);
+            iv_8[i] = 0xf0 - m - i;
+            jobs[m].iv |= (uint64_t) iv_8[i] << (8 * i);
+        }
+        for (size_t i = 0; i < offset + lens[m]; i++) {
+            msg[i] = i * 11 + m;
+        }
+
+        ECRYPT_ctx ctx;
+        ECRYPT_keysetup(&ctx, k_8, 256, 0);
+        ECRYPT_ivsetup(&ctx, iv_8);
+        ECRYPT_encrypt_bytes(&ctx, msg, expected[m], offset + lens[m]);
+
+        jobs[m].len = lens[m];
+        jobs[m].in = msg + offset;
+        jobs[m].out = out;
+        jobs[m].offset = offset;
+    }
+
+    salsa20_crypt_multi(n, jobs);
+
+    for (size_t m = 0; m < n; m++) {
+        failed |= memcmp(expected[m] + jobs[m].offset, jobs[m].out, lens[m]) != 0;
+        free((uint8_t*) jobs[m].in - jobs[m].offset);
+        free(jobs[m].out);
+        free(expected[m]);
+    }
+
+    if (!failed) {
+        printf("multi-buffer-crypt (%lu streams with own keys) is\x1B[1;36m equivalent\x1B[0m to the reference implementation\n", n);
+    } else {
+        printf("multi-buffer-crypt (%lu streams with own keys) is\x1B[1;31m not equivalent\x1B[0m to the reference implementation!\n", n);
+    }
+    return failed;
+}
+
+/*  Encrypts records of 0 to 5000 bytes with their own nonces at once with
+*   salsa20_crypt_batch and compares every record with the reference implementation.
+*   Also covers the multi-buffer cores and crypt, whose lanes have their own keys.
+*/
+int verify_batch(){
+    int failed = 0;
+
+    if (verify_core_lanes("x4-lanes-core", salsa20_core_x4_lanes, 4)) {
+        failed++;
+    }
+    if (cpu_features() & CPU_FEATURE_AVX2) {
+        if (verify_core_lanes("x8-lanes-core", salsa20_core_x8_lanes, 8)) {
+            failed++;
+        }
+    } else {
+        printf("Skipping x8-lanes-core, the CPU does not support AVX2\n");
+    }
+
+    u8 k_8[32];
+    uint32_t k_32[8];
+    for (size_t i = 0; i < 32; i++) {
+        k_8[i] = i * 13 + 3;
+    }
+    for (size_t i = 0; i < 8; i++) {
+        k_32[i] = U8TO32_LITTLE(k_8 + 4 * i);
+    }
+
+    size_t lens[] = { 64, 1, 0, 63, 65, 1500, 128, 200, 5000, 17, 64, 64, 64, 1000, 3, 640 };
+    size_t n = sizeof(lens) / sizeof(lens[0]);
+    uint8_t* ins[sizeof(lens) / sizeof(lens[0])];
+    uint8_t* outs[sizeof(lens) / sizeof(lens[0])];
+    uint8_t* expected[sizeof(lens) / sizeof(lens[0])];
+    uint64_t ivs[sizeof(lens) / sizeof(lens[0])];
+
+    for (size_t m = 0; m < n; m++) {
+        ins[m] = malloc(lens[m] + 1);
+        outs[m] = malloc(lens[m] + 1);
+        expected[m] = malloc(lens[m] + 1);
+        if (!ins[m] || !outs[m] || !expected[m]) {
+            fprintf(stderr, "Could not allocate enough memory for the verification of the batch crypt\n");
+            exit(EXIT_FAILURE);
+        }
+
+        u8 iv_8[8];
+        ivs[m] = 0;
+        for (size_t i = 0; i < 8; i++) {
+            iv_8[i] = m * 17 + i;
+            ivs[m] |= (uint64_t) iv_8[i] << (8 * i);
+        }
+        for (size_t i = 0; i < lens[m]; i++) {
+            ins[m][i] = i * 7 + m;
+        }
+
+        ECRYPT_ctx ctx;
+        ECRYPT_keysetup(&ctx, k_8, 256, 0);
+        ECRYPT_ivsetup(&ctx, iv_8);
+        ECRYPT_encrypt_bytes(&ctx, ins[m], expected[m], lens[m]);
+    }
+
+    salsa20_crypt_batch(n, lens, (const uint8_t* const*) ins, outs, k_32, ivs);
+
+    int batch_failed = 0;
+    for (size_t m = 0; m < n; m++) {
+        batch_failed |= memcmp(expected[m], outs[m], lens[m]) != 0;
+    }
+
+    // In place, the records are decrypted again
+    salsa20_crypt_batch(n, lens, (const uint8_t* const*) outs, outs, k_32, ivs);
+    for (size_t m = 0; m < n; m++) {
+        batch_failed |= memcmp(ins[m], outs[m], lens[m]) != 0;
+    }
+
+    if (!batch_failed) {
+        printf("batch-crypt (%lu records of 0 to 5000 bytes) is\x1B[1;36m equivalent\x1B[0m to the reference implementation\n", n);
+    } else {
+        printf("batch-crypt (%lu records of 0 to 5000 bytes) is\x1B[1;31m not equivalent\x1B[0m to the reference implementation!\n", n);
+        failed++;
+    }
+
+    for (size_t m = 0; m < n; m++) {
+        free(ins[m]);
+        free(outs[m]);
+        free(expected[m]);
+    }
+
+    if (verify_core_multi("x4-multi-core", salsa20_core_x4_multi, 4)) {
+        failed++;
+    }
+    if (cpu_features() & CPU_FEATURE_AVX2) {
+        if (verify_core_multi("x8-multi-core", salsa20_core_x8_multi, 8)) {
+            failed++;
+        }
+    } else {
+        printf("Skipping x8-multi-core, the CPU does not support AVX2\n");
+    }
+    if (verify_crypt_multi()) {
+        failed++;
+    }
+    return failed;
+}
+
+// Compares the contents of the file at path with the expected bytes
+static int verify_file_contents(const char* name, const char* path, const uint8_t* expected, size_t len) {
+    struct FileText* filetext = read_file(path);
+    int failed = !filetext || filetext->len != len || memcmp(filetext->str, expected, len);
+
+    if (!failed) {
+        printf("%s is\x1B[1;36m equivalent\x1B[0m to the reference implementation\n", name);
+    } else {
+        printf("%s is\x1B[1;31m not equivalent\x1B[0m to the reference implementation!\n", name);
+    }
+
+    if (filetext) {
+        free(filetext->str);
+        free(filetext);
+    }
+    return failed;
+}
+
+// Draws 100000 random bytes in the calling thread of verify_random
+static void* verify_random_thread(void* arg) {
+    if (salsa20_random(arg, 100000)) {
+        return arg;
+    }
+    salsa20_random_wipe();
+    return NULL;
+}
+
+/*  There is no reference for the output of the DRBG, as it is seeded by the kernel.
+*   The checks are that consecutive draws (buffered and direct) and draws of another
+*   thread differ, and that about half of the bits are set.
+*/
+static int verify_random(void) {
+    size_t len = 100000;
+    size_t big = (1 << 20) + 100;
+    uint8_t* a = malloc(big);
+    uint8_t* b = malloc(len);
+    uint8_t* c = malloc(len);
+    int failed = !a || !b || !c;
+    pthread_t thread;
+
+    if (!failed) {
+        failed |= salsa20_random(a, len) != 0;
+        failed |= salsa20_random(b, len) != 0;
+        failed |= pthread_create(&thread, NULL, verify_random_thread, c) != 0;
+        if (!failed) {
+            void* ret;
+            pthread_join(thread, &ret);
+            failed |= ret != NULL;
+        }
+        failed |= !memcmp(a, b, len) || !memcmp(a, c, len) || !memcmp(b, c, len);
+
+        // A request of more than 1 MiB is generated directly into the output
+        failed |= salsa20_random(a, big) != 0;
+        failed |= !memcmp(a + big - len, b, len);
+
+        uint64_t bits = 0;
+        for (size_t i = 0; i < big; i++) {
+            bits += __builtin_popcount(a[i]);
+        }
+        failed |= bits < 0.499 * 8 * big || bits > 0.501 * 8 * big;
+    }
+
+    if (!failed) {
+        printf("DRBG draws of two threads are\x1B[1;36m distinct\x1B[0m and balanced\n");
+    } else {
+        printf("DRBG draws are\x1B[1;31m not distinct\x1B[0m or not balanced!\n");
+    }
+
+    free(a);
+    free(b);
+    free(c);
+    return failed;
+}
+
+/*  Runs the pipeline many times with all of its threads on one CPU, where the stages
+*   take turns on the rings and sleep on their futexes all the time. A lost wakeup
+*   makes this test hang instead of failing.
+*/
+static int verify_pipeline_single_cpu(const char* in_path, const char* out_path, const uint8_t* msg, size_t mlen) {
+    const struct salsa20_impl* impl = salsa20_dispatch();
+    uint32_t key[8] = { 0 };
+    cpu_set_t old_set;
+    cpu_set_t one;
+    int failed = 0;
+    size_t runs = 300;
+
+    // The threads of the pipeline inherit the affinity of the calling thread
+    if (pthread_getaffinity_np(pthread_self(), sizeof(old_set), &old_set)) {
+        printf("Could not read the CPU affinity for the single CPU pipeline test\n");
+        return 1;
+    }
+    CPU_ZERO(&one);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &old_set)) {
+            CPU_SET(cpu, &one);
+            break;
+        }
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+
+    uint8_t* reference = malloc(mlen);
+    if (!reference) {
+        pthread_setaffinity_np(pthread_self(), sizeof(old_set), &old_set);
+        return 1;
+    }
+    memcpy(reference, msg, mlen);
+    impl->crypt(mlen, reference, reference, key, 0, 0, impl->core);
+
+    for (size_t i = 0; i < runs && !failed; i++) {
+        int pipe_in = open(in_path, O_RDONLY);
+        int pipe_out = open(out_path, O_WRONLY | O_TRUNC);
+
+        // Alternating one and three encryptors, 512 byte chunks keep the rings busy
+        if (pipe_in < 0 || pipe_out < 0 || crypt_fd_pipeline(pipe_in, pipe_out, 512, 1 + 2 * (i % 2), impl->crypt, impl->core, key, 0, 0, UINT64_MAX)) {
+            failed++;
+        }
+        if (pipe_in >= 0) {
+            close(pipe_in);
+        }
+        if (pipe_out >= 0) {
+            close(pipe_out);
+        }
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(old_set), &old_set);
+
+    // The output of the last run is checked
+    char name[64];
+    snprintf(name, sizeof(name), "Pipeline on one CPU (%lu runs)", runs);
+    if (failed || verify_file_contents(name, out_path, reference, mlen)) {
+        failed = 1;
+    }
+    free(reference);
+    return failed;
+}
+
+int verify_stream(){
+    int failed = 0;
+
+    u8 k_8[32];
+    uint32_t k_32[8];
+    u8 iv_8[8];
+    uint64_t iv = 0;
+
+    for (size_t i = 0; i < 32; i++) {
+        k_8[i] = 255 - i;
+    }
+    for (size_t i = 0; i < 8; i++) {
+        k_32[i] = U8TO32_LITTLE(k_8 + 4 * i);
+        iv_8[i] = i;
+        iv |= (uint64_t) iv_8[i] << (8 * i);
+    }
+
+    size_t mlen = 20000;
+    uint8_t* msg = malloc(mlen);
+    uint8_t* expected = malloc(mlen);
+    uint8_t* actual = malloc(mlen);
+    if (!msg || !expected || !actual) {
+        fprintf(stderr, "Could not allocate enough memory for the verification of the stream context\n");
+        free(msg);
+        free(expected);
+        free(actual);
+        return 1;
+    }
+
+    for (size_t i = 0; i < mlen; i++) {
+        msg[i] = i * 13 + 1;
+    }
+
+    ECRYPT_ctx m;
+    ECRYPT_keysetup(&m, k_8, 256, 0);
+    ECRYPT_ivsetup(&m, iv_8);
+    ECRYPT_encrypt_bytes(&m, msg, expected, mlen);
+
+    // Fragment the message into chunks that are mostly not multiples of the block size
+    size_t chunks[] = { 1, 63, 64, 65, 200, 7, 4096, 500, 0, 1300 };
+    struct salsa20_ctx ctx;
+    salsa20_init(&ctx, k_32, iv);
+
+    size_t n = 0;
+    for (size_t i = 0; n < mlen; i = (i + 1) % (sizeof(chunks) / sizeof(chunks[0]))) {
+        size_t len = chunks[i] < mlen - n ? chunks[i] : mlen - n;
+        salsa20_update(&ctx, msg + n, actual + n, len);
+        n += len;
+    }
+    salsa20_final(&ctx);
+
+    if (!memcmp(expected, actual, mlen)) {
+        printf("Fragmented stream (%lu bytes) is\x1B[1;36m equivalent\x1B[0m to the reference implementation\n", mlen);
+    } else {
+        printf("Fragmented stream (%lu bytes) is\x1B[1;31m not equivalent\x1B[0m to the reference implementation!\n", mlen);
+        failed++;
+    }
+
+    // Decrypt in place with a different fragmentation
+    salsa20_init(&ctx, k_32, iv);
+    for (n = 0; n < mlen; n += 333) {
+        salsa20_update(&ctx, actual + n, actual + n, 333 < mlen - n ? 333 : mlen - n);
+    }
+    salsa20_final(&ctx);
+
+    if (!memcmp(msg, actual, mlen)) {
+        printf("In-place stream decryption\x1B[1;36m restores\x1B[0m the message\n");
+    } else {
+        printf("In-place stream decryption does\x1B[1;31m not restore\x1B[0m the message!\n");
+        failed++;
+    }
+
+    // Key stream only, in pieces that use the multi-block core for some groups of blocks
+    uint8_t* key_stream = malloc(mlen);
+    if (!key_stream) {
+        fprintf(stderr, "Could not allocate enough memory for the verification of the key stream\n");
+        failed++;
+    } else {
+        size_t pieces[] = { 3, 61, 1024, 2053, 64, 0, 700, 4096 };
+        ECRYPT_keysetup(&m, k_8, 256, 0);
+        ECRYPT_ivsetup(&m, iv_8);
+        ECRYPT_keystream_bytes(&m, expected, mlen);
+
+        salsa20_init(&ctx, k_32, iv);
+        n = 0;
+        for (size_t i = 0; n < mlen; i = (i + 1) % (sizeof(pieces) / sizeof(pieces[0]))) {
+            size_t len = pieces[i] < mlen - n ? pieces[i] : mlen - n;
+            salsa20_keystream(&ctx, key_stream + n, len);
+            n += len;
+        }
+        salsa20_final(&ctx);
+
+        if (!memcmp(expected, key_stream, mlen)) {
+            printf("Fragmented key stream (%lu bytes) is\x1B[1;36m equivalent\x1B[0m to the reference implementation\n", mlen);
+        } else {
+            printf("Fragmented key stream (%lu bytes) is\x1B[1;31m not equivalent\x1B[0m to the reference implementation!\n", mlen);
+            failed++;
+        }
+        free(key_stream);
+
+        // The file mode tests below expect the cipher text again
+        ECRYPT_keysetup(&m, k_8, 256, 0);
+        ECRYPT_ivsetup(&m, iv_8);
+        ECRYPT_encrypt_bytes(&m, msg, expected, mlen);
+    }
+
+    if (verify_random()) {
+        failed++;
+    }
+
+    // Streaming file mode with a chunk size that is not a multiple of the block size
+    char in_path[] = "/tmp/salsa20_verify_in_XXXXXX";
+    char out_path[] = "/tmp/salsa20_verify_out_XXXXXX";
+    int in_fd = mkstemp(in_path);
+    int out_fd = mkstemp(out_path);
+
+    if (in_fd < 0 || out_fd < 0 || write_file(in_path, msg, mlen)) {
+        printf("Could not create temporary files for the streaming file mode\n");
+        failed++;
+    } else {
+        const struct salsa20_impl* impl = salsa20_dispatch();
+        if (crypt_file_stream(in_path, out_path, 1000, impl->crypt, impl->core, k_32, iv, 0, UINT64_MAX)
+            || verify_file_contents("Streaming file mode (1000 byte chunks)", out_path, expected, mlen)) {
+            failed++;
+        }
+        if (crypt_file_mmap(in_path, out_path, impl->crypt, impl->core, k_32, iv, 0, UINT64_MAX)
+            || verify_file_contents("mmap file mode", out_path, expected, mlen)) {
+            failed++;
+        }
+        if (crypt_file_uring(in_path, out_path, 1000, 3, impl->crypt, impl->core, k_32, iv, 0, UINT64_MAX)
+            || verify_file_contents("io_uring file mode (1000 byte chunks, 3 requests)", out_path, expected, mlen)) {
+            failed++;
+        }
+        if (crypt_file_double_buffer(in_path, out_path, 1000, impl->crypt, impl->core, k_32, iv, 0, UINT64_MAX)
+            || verify_file_contents("Double buffer file mode (1000 byte chunks)", out_path, expected, mlen)) {
+            failed++;
+        }
+        if (crypt_file_uring(in_path, out_path, 4096, 2, impl->crypt, impl->core, k_32, iv, 4099, 5000)
+            || verify_file_contents("io_uring file mode (5000 bytes at offset 4099)", out_path, expected + 4099, 5000)) {
+            failed++;
+        }
+        // Pipeline with three encryptor threads, the file descriptors stand in for pipes
+        int pipe_in = open(in_path, O_RDONLY);
+        int pipe_out = open(out_path, O_WRONLY | O_TRUNC);
+        if (pipe_in < 0 || pipe_out < 0
+            || crypt_fd_pipeline(pipe_in, pipe_out, 1000, 3, impl->crypt, impl->core, k_32, iv, 0, UINT64_MAX)
+            || verify_file_contents("Pipeline (3 encryptor threads, 1000 byte chunks)", out_path, expected, mlen)) {
+            failed++;
+        }
+        if (pipe_in >= 0) {
+            close(pipe_in);
+        }
+        if (pipe_out >= 0) {
+            close(pipe_out);
+        }
+        failed += verify_pipeline_single_cpu(in_path, out_path, msg, mlen);
+        // In-place mode encrypts the input file mapped and decrypts it again with pread/pwrite
+        if (crypt_file_inplace(in_path, 0, impl->crypt, impl->core, k_32, iv, 0, UINT64_MAX)
+            || verify_file_contents("In-place file mode (mapped)", in_path, expected, mlen)) {
+            failed++;
+        }
+        if (crypt_file_inplace(in_path, 777, impl->crypt, impl->core, k_32, iv, 0, UINT64_MAX)
+            || verify_file_contents("In-place file mode (777 byte chunks)", in_path, msg, mlen)) {
+            failed++;
+        }
+        // A slice that does not start at a page boundary checks the alignment of the mapping
+        if (crypt_file_mmap(in_path, out_path, impl->crypt, impl->core, k_32, iv, 4099, 5000)
+            || verify_file_contents("mmap file mode (5000 bytes at offset 4099)", out_path, expected + 4099, 5000)) {
+            failed++;
+        }
+    }
+
+    if (in_fd >= 0) {
+        close(in_fd);
+        unlink(in_path);
+    }
+    if (out_fd >= 0) {
+        close(out_fd);
+        unlink(out_path);
+    }
+
+    free(msg);
+    free(expected);
+    free(actual);
+    return failed;
+}
+
+/*  Compares the single-block cores and the first lane of the multi-block cores of one
+*   round count with the expected output matrix. The other lanes of the multi-block
+*   cores are compared with core_v2 of the same round count (see verify_core).
+*/
+static int verify_core_rounds(uint32_t rounds, const core_func singles[4], const core_func wides[3], const uint32_t in[16], const uint32_t expected[16]) {
+    const char* wide_names[] = { "x4", "x8", "x16" };
+    const uint32_t wide_features[] = { CPU_FEATURE_SSE2, CPU_FEATURE_AVX2, CPU_FEATURE_AVX512F };
+    uint32_t out[16];
+    int failed = 0;
+
+    for (size_t v = 0; v < 4; v++) {
+        printf("Comparing v%lu \x1B[1;36m	(Salsa20/%u) \x1B[0m	and reference matrix...\n", v, rounds);
+        singles[v](out, in);
+        if (mtr_equal(out, (uint32_t*) expected)) {
+            failed++;
+        }
+    }
+
+    for (size_t w = 0; w < 3; w++) {
+        size_t width = 4 << w;
+        uint32_t out_wide[256];
+        uint32_t block_in[16];
+
+        if ((cpu_features() & wide_features[w]) != wide_features[w]) {
+            printf("Skipping %s \x1B[1;36m	(Salsa20/%u) \x1B[0m	the CPU does not support it\n", wide_names[w], rounds);
+            continue;
+        }
+
+        printf("Comparing %s \x1B[1;36m	(Salsa20/%u) \x1B[0m	and reference matrix / v2 blocks...\n", wide_names[w], rounds);
+        wides[w](out_wide, in);
+        if (mtr_equal(out_wide, (uint32_t*) expected)) {
+            failed++;
+        }
+
+        memcpy(block_in, in, sizeof(block_in));
+        int lanes_failed = 0;
+        for (size_t j = 1; j < width; j++) {
+            block_in[9] += (++block_in[8] == 0);
+            singles[2](out, block_in);
+            lanes_failed |= memcmp(out_wide + 16 * j, out, sizeof(out)) != 0;
+        }
+        if (lanes_failed) {
+            printf("The other %lu blocks of %s are\x1B[1;31m not equivalent\x1B[0m to v2-core!\n", width - 1, wide_names[w]);
+            failed++;
+        }
+    }
+    printf("\n");
+
+    return failed;
+}
+
+// Compares len bytes with the expected bytes, given as hex string (of any length, byte by byte)
+static int verify_bytes(const char* name, const uint8_t* actual, const char* expected_hex, size_t len) {
+    int equal = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t expected = 0;
+        sscanf(expected_hex + 2 * i, "%2hhx", &expected);
+        equal &= actual[i] == expected;
+    }
+
+    if (equal) {
+        printf("%s is\x1B[1;36m equivalent\x1B[0m to the test vector\n", name);
+        return 0;
+    }
+    printf("%s is\x1B[1;31m not equivalent\x1B[0m to the test vector!\n", name);
+    return 1;
+}
+
+/*  Every version of the given round count is compared with salsa20_crypt_v0 and core_v2
+*   of the same round count, called through function pointers. Those two only differ
+*   from the checked Salsa20/20 path in the number of rounds, which is covered by the
+*   core vectors.
+*/
+static int verify_crypt_rounds(uint32_t rounds, core_func core, size_t mlen, uint64_t offset) {
+    uint32_t key[8] = { 0x04030201, 0x08070605, 0x0c0b0a09, 0x100f0e0d, 0xc9c8c7c6, 0xcdcccbca, 0xd1d0cfce, 0xd5d4d3d2 };
+    uint64_t iv = 0xa7a6a5a4a3a2a1a0;
+    uint8_t* msg = malloc(mlen);
+    uint8_t* expected = malloc(mlen);
+    uint8_t* actual = malloc(mlen);
+    int failed = 0;
+
+    if (!msg || !expected || !actual) {
+        fprintf(stderr, "Could not allocate enough memory for the verification of Salsa20/%u\n", rounds);
+        free(msg);
+        free(expected);
+        free(actual);
+        return 1;
+    }
+
+    for (size_t i = 0; i < mlen; i++) {
+        msg[i] = i * 31 + 5;
+    }
+    salsa20_crypt_v0(mlen, msg, expected, key, iv, offset, core);
+
+    const struct salsa20_impl* impl;
+    for (uint32_t version = 0; version <= 14; version++) {
+        if (!(impl = salsa20_get_impl_rounds(version, rounds)) || !salsa20_impl_supported(impl)) {
+            continue;
+        }
+
+        impl->crypt(mlen, msg, actual, key, iv, offset, impl->core);
+        int version_failed = memcmp(expected, actual, mlen) != 0;
+
+        if (!version_failed) {
+            printf("%s, Salsa20/%u (%lu bytes at offset %lu) is\x1B[1;36m equivalent\x1B[0m to v0-crypt with v2-core\n", impl->description, rounds, mlen, offset);
+        } else {
+            printf("%s, Salsa20/%u (%lu bytes at offset %lu) is\x1B[1;31m not equivalent\x1B[0m to v0-crypt with v2-core!\n", impl->description, rounds, mlen, offset);
+            failed++;
+        }
+    }
+
+    free(msg);
+    free(expected);
+    free(actual);
+    return failed;
+}
+
+/*  eSTREAM Salsa20/12, 256-bit key set 1 vector 0 (key 0x80 followed by zeros, iv 0),
+*   a keystream of 512 bytes for every version, so the multi-block cores are covered.
+*/
+static int verify_crypt_estream_r12(void) {
+    uint32_t key[8] = { 0x00000080, 0, 0, 0, 0, 0, 0, 0 };
+    uint8_t zeros[512] = { 0 };
+    uint8_t stream[512];
+    int failed = 0;
+
+    const struct salsa20_impl* impl;
+    for (uint32_t version = 0; version <= 14; version++) {
+        if (!(impl = salsa20_get_impl_rounds(version, 12)) || !salsa20_impl_supported(impl)) {
+            continue;
+        }
+
+        impl->crypt(sizeof(stream), zeros, stream, key, 0, 0, impl->core);
+
+        char name[160];
+        snprintf(name, sizeof(name), "%s, Salsa20/12 eSTREAM stream[0..63]", impl->description);
+        failed += verify_bytes(name, stream,
+            "AFE411ED1C4E07E4D0CDE3B33E31EC190FA4CC796A58BAFB848EAD8D07D02CD2"
+            "D4B6F9F30CB0B57007E3733895CC8D1060107975ACAEEB689B6CF614AB64A3D6", 64);
+        snprintf(name, sizeof(name), "%s, Salsa20/12 eSTREAM stream[192..319]", impl->description);
+        failed += verify_bytes(name, stream + 192,
+            "8966E93E875E8065AC6F3A1A3E2146F83D5EA93CA987FF9F13ED6ADE169665AE"
+            "3527FCA5613AF081C0E773DA6E7C74C5642ECAC53FEBF15A699AC2C8255CC100"
+            "C89DB39DD8872492ABF8109462B3639BB18C64ED500B70D2836B6194D11A77AC"
+            "8C14DD8E1DF0B3924DDA24563E2719E2635C61F63B9AE60D56D5F3512851B4B1", 128);
+        snprintf(name, sizeof(name), "%s, Salsa20/12 eSTREAM stream[448..511]", impl->description);
+        failed += verify_bytes(name, stream + 448,
+            "87A5191EC2E3C9049FA524CD8673E0677C77ADCF8AB5328FD828C4ACB3ECCCA5"
+            "49ADEDA04872518ECDF874ADCB2420C7BD1CCFE561B074080224FA7176F0CB5F", 64);
+    }
+    printf("\n");
+
+    return failed;
+}
+
+/*  Reduced round versions. The Salsa20/8 vector is the one of RFC 7914 (section 8),
+*   the Salsa20/12 core vector is the first block of the eSTREAM 128-bit key set 1
+*   vector 0 (key 0x80 followed by zeros, iv 0).
+*/
+int verify_rounds(){
+    int failed = 0;
+
+    uint32_t rfc7914_in[] = {
+        0x219a877e, 0x86c93e4f, 0xe640a97c, 0x268f7141,
+        0x5b55eeba, 0xb5c1618c, 0x1146f80d, 0x1d3bcd6d,
+        0x19f324ee, 0x853d9bdf, 0x4b1e1214, 0x32aac55a,
+        0x291d0276, 0x2948c709, 0x8dc6ebed, 0x5ec2b8b8
+    };
+
+    uint32_t rfc7914_out_r8[] = {
+        0x9c851fa4, 0x99cc0866, 0xcbca813b, 0x05ef0c02,
+        0x81214b04, 0x7d33fda2, 0x631c7bfd, 0x292f6896,
+        0x683139b4, 0xbce6c9e3, 0xb7c56bfe, 0xba966da0,
+        0x10cc24e4, 0x5c74912c, 0x3d67ad24, 0x818f61c7
+    };
+
+    uint32_t estream_in_r12[] = {
+        0x61707865, 0x00000080, 0x00000000, 0x00000000,
+        0x00000000, 0x3120646e, 0x00000000, 0x00000000,
+        0x00000000, 0x00000000, 0x79622d36, 0x00000080,
+        0x00000000, 0x00000000, 0x00000000, 0x6b206574
+    };
+
+    // FC207DBF C76C5E17 74961E7A ... as little-endian words
+    uint32_t estream_out_r12[] = {
+        0xbf7d20fc, 0x175e6cc7, 0x7a1e9674, 0x0609ad5a,
+        0xac25229b, 0x7afee01c, 0x0370e70c, 0xf8bde5e7,
+        0x21f81ab3, 0xe6130800, 0x178c6bc5, 0x70eed671,
+        0xd0fbb239, 0xd78a8ea6, 0xb644390a, 0x97789377
+    };
+
+    const core_func singles_r8[] = { salsa20_core_v0_r8, salsa20_core_v1_r8, salsa20_core_v2_r8, salsa20_core_v3_r8 };
+    const core_func wides_r8[] = { salsa20_core_x4_r8, salsa20_core_x8_r8, salsa20_core_x16_r8 };
+    const core_func singles_r12[] = { salsa20_core_v0_r12, salsa20_core_v1_r12, salsa20_core_v2_r12, salsa20_core_v3_r12 };
+    const core_func wides_r12[] = { salsa20_core_x4_r12, salsa20_core_x8_r12, salsa20_core_x16_r12 };
+
+    failed += verify_core_rounds(8, singles_r8, wides_r8, rfc7914_in, rfc7914_out_r8);
+    failed += verify_core_rounds(12, singles_r12, wides_r12, estream_in_r12, estream_out_r12);
+    failed += verify_crypt_estream_r12();
+
+    // Long enough for the tiles of V11/V12 and the 1 KiB steps of V9, the offsets are not block aligned
+    failed += verify_crypt_rounds(8, salsa20_core_v2_r8, 2500, 4099);
+    failed += verify_crypt_rounds(12, salsa20_core_v2_r12, 2500, 7);
+    printf("\n");
+
+    // The non-temporal bulk path takes the multi-block core of the version as well
+    salsa20_set_nt_threshold(1);
+    failed += verify_crypt_rounds(8, salsa20_core_v2_r8, 5003, 37);
+    failed += verify_crypt_rounds(12, salsa20_core_v2_r12, 5003, 37);
+    salsa20_set_nt_threshold(0);
+    printf("\n");
+
+    // Around the wrap of the low counter word, where V13/V14 recompute the first round
+    uint64_t wrap = ((1ULL << 32) - 20) * 64 + 5;
+    failed += verify_crypt_rounds(20, salsa20_core_v2, 5003, wrap);
+    failed += verify_crypt_rounds(12, salsa20_core_v2_r12, 5003, wrap);
+    failed += verify_crypt_rounds(8, salsa20_core_v2_r8, 5003, wrap);
+    printf("\n");
+
+    return failed;
+}
+
+/*  SHA-256 (FIPS 180-2, "abc"), the PBKDF2-HMAC-SHA256 and scrypt vectors of RFC 7914
+*   (sections 11 and 12). The last scrypt vector (N = 2^20, 1 GiB per lane) is left out,
+*   the (1024, 8, 16) one runs with one thread per lane, on four threads and on one.
+*/
+int verify_scrypt(){
+    int failed = 0;
+    uint8_t out[64];
+
+    struct sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, (const uint8_t*) "abc", 3);
+    sha256_final(&ctx, out);
+    failed += verify_bytes("sha256(\"abc\")", out, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", 32);
+
+    pbkdf2_sha256((const uint8_t*) "passwd", 6, (const uint8_t*) "salt", 4, 1, out, 64);
+    failed += verify_bytes("PBKDF2-HMAC-SHA256 (\"passwd\", \"salt\", 1)", out,
+        "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+        "49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783", 64);
+
+    pbkdf2_sha256((const uint8_t*) "Password", 8, (const uint8_t*) "NaCl", 4, 80000, out, 64);
+    failed += verify_bytes("PBKDF2-HMAC-SHA256 (\"Password\", \"NaCl\", 80000)", out,
+        "4ddcd8f60b98be21830cee5ef22701f9641a4418d04c0414aeff08876b34ab56"
+        "a1d425a1225833549adb841b51c9b3176a272bdebba1d078478f62b397f33c8d", 64);
+
+    if (scrypt((const uint8_t*) "", 0, (const uint8_t*) "", 0, 16, 1, 1, 0, out, 64)) {
+        failed++;
+    } else {
+        failed += verify_bytes("scrypt (\"\", \"\", N = 16, r = 1, p = 1)", out,
+            "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+            "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906", 64);
+    }
+
+    const size_t nthreads[] = { 0, 4, 1 };
+    for (size_t t = 0; t < 3; t++) {
+        char name[96];
+        snprintf(name, sizeof(name), "scrypt (\"password\", \"NaCl\", N = 1024, r = 8, p = 16) on %lu threads", nthreads[t] ? nthreads[t] : 16);
+        if (scrypt((const uint8_t*) "password", 8, (const uint8_t*) "NaCl", 4, 1024, 8, 16, nthreads[t], out, 64)) {
+            failed++;
+            continue;
+        }
+        failed += verify_bytes(name, out,
+            "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+            "2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640", 64);
+    }
+
+    if (scrypt((const uint8_t*) "pleaseletmein", 13, (const uint8_t*) "SodiumChloride", 14, 16384, 8, 1, 0, out, 64)) {
+        failed++;
+    } else {
+        failed += verify_bytes("scrypt (\"pleaseletmein\", \"SodiumChloride\", N = 16384, r = 8, p = 1)", out,
+            "7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"
+            "d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887", 64);
+    }
+    printf("\n");
+
+    return failed;
+}
+
+/*  HSalsa20 with the core1 and core2 vectors of NaCl, XSalsa20 with its stream3 vector
+*   (the first 32 bytes) and the SHA-256 of 4 MiB of key stream (tests/stream.c). The
+*   cached subkeys are compared with hsalsa20 for more nonce prefixes than the cache has
+*   entries, the same key with several prefixes and the same prefix with several keys.
+*/
+int verify_xsalsa20(){
+    int failed = 0;
+    uint32_t key[8];
+    uint32_t subkey[8];
+    uint8_t nonce[24];
+    uint8_t out[64];
+
+    uint8_t shared[32];
+    for (size_t i = 0; i < 32; i++) {
+        sscanf("4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742" + 2 * i, "%2hhx", &shared[i]);
+    }
+    memcpy(key, shared, 32);
+    memset(nonce, 0, 16);
+    hsalsa20(subkey, key, nonce);
+    failed += verify_bytes("hsalsa20 (NaCl core1)", (uint8_t*) subkey, "1b27556473e985d462cd51197a9a46c76009549eac6474f206c4ee0844f68389", 32);
+
+    memcpy(key, subkey, 32);
+    for (size_t i = 0; i < 24; i++) {
+        sscanf("69696ee955b62b73cd62bda875fc73d68219e0036b7a0b37" + 2 * i, "%2hhx", &nonce[i]);
+    }
+    hsalsa20(subkey, key, nonce);
+    failed += verify_bytes("hsalsa20 (NaCl core2)", (uint8_t*) subkey, "dc908dda0b9344a953629b733820778880f3ceb421bb61b91cbd4c3e66256ce4", 32);
+
+    xsalsa20_cache_wipe();
+    memset(out, 0, 32);
+    xsalsa20_crypt(32, out, out, key, nonce, 0);
+    failed += verify_bytes("xsalsa20_crypt (NaCl stream3)", out, "eea6a7251c1e72916d11c2cb214d3c252539121d8e234e652d651fa4c8cff880", 32);
+
+    size_t mlen = 4194304;
+    uint8_t* stream = calloc(mlen, 1);
+    if (!stream) {
+        fprintf(stderr, "Could not allocate enough memory for the verification of XSalsa20\n");
+        return failed + 1;
+    }
+    xsalsa20_crypt(mlen, stream, stream, key, nonce, 0);
+
+    struct sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, stream, mlen);
+    sha256_final(&ctx, out);
+    failed += verify_bytes("xsalsa20_crypt (NaCl stream, sha256 of 4 MiB)", out, "662b9d0e3463029156069b12f918691a98f7dfb2ca0393c96bbfc6b1fbd630a2", 32);
+
+    // The incremental interface in pieces of odd length
+    struct salsa20_ctx sctx;
+    uint8_t* actual = calloc(mlen, 1);
+    if (!actual) {
+        fprintf(stderr, "Could not allocate enough memory for the verification of XSalsa20\n");
+        free(stream);
+        return failed + 1;
+    }
+    xsalsa20_init(&sctx, key, nonce);
+    for (size_t n = 0; n < mlen; n += 100003) {
+        salsa20_update(&sctx, actual + n, actual + n, mlen - n < 100003 ? mlen - n : 100003);
+    }
+    salsa20_final(&sctx);
+    if (!memcmp(stream, actual, mlen)) {
+        printf("xsalsa20_init and salsa20_update are\x1B[1;36m equivalent\x1B[0m to xsalsa20_crypt\n");
+    } else {
+        printf("xsalsa20_init and salsa20_update are\x1B[1;31m not equivalent\x1B[0m to xsalsa20_crypt!\n");
+        failed++;
+    }
+    free(stream);
+    free(actual);
+
+    // 3 keys with 40 prefixes each, twice: evicted and colliding entries must never be mixed up
+    uint64_t hits, misses;
+    int cache_failed = 0;
+    xsalsa20_cache_wipe();
+    for (size_t round = 0; round < 2; round++) {
+        for (uint32_t k = 0; k < 3; k++) {
+            for (uint32_t p = 0; p < 40; p++) {
+                uint32_t expected[8];
+                key[0] = k;
+                memcpy(nonce, &p, sizeof(p));
+                hsalsa20(expected, key, nonce);
+                xsalsa20_subkey(subkey, key, nonce);
+                cache_failed |= memcmp(subkey, expected, sizeof(expected)) != 0;
+
+                // A second message with the same prefix is a hit
+                nonce[23]++;
+                xsalsa20_subkey(subkey, key, nonce);
+                cache_failed |= memcmp(subkey, expected, sizeof(expected)) != 0;
+            }
+        }
+    }
+    xsalsa20_cache_stats(&hits, &misses);
+    xsalsa20_cache_wipe();
+
+    if (!cache_failed && hits >= 240 && hits + misses == 480) {
+        printf("xsalsa20_subkey (%lu hits, %lu misses) is\x1B[1;36m equivalent\x1B[0m to hsalsa20\n", hits, misses);
+    } else {
+        printf("xsalsa20_subkey (%lu hits, %lu misses) is\x1B[1;31m not equivalent\x1B[0m to hsalsa20!\n", hits, misses);
+        failed++;
+    }
+    printf("\n");
+
+    return failed;
+}
+
+// Converts len bytes from hex, the vectors below are given as strings
+static void verify_hex(uint8_t* out, const char* hex, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        sscanf(hex + 2 * i, "%2hhx", &out[i]);
+    }
+}
+
+/*  Poly1305 with the vectors of RFC 8439 (section 2.5.2 and the reduction corner cases
+*   5 to 7 of appendix A.3) and a 1000 byte message whose tag was computed with an
+*   independent implementation. The long message goes through the scalar, SSE2 and
+*   AVX2 code, in one piece and in pieces of odd length.
+*/
+static int verify_poly1305(void) {
+    const uint32_t features[] = { 0, CPU_FEATURE_SSE2, CPU_FEATURE_AVX2 };
+    const char* names[] = { "scalar", "SSE2", "AVX2" };
+    uint8_t key[POLY1305_KEY_SIZE];
+    uint8_t tag[POLY1305_TAG_SIZE];
+    uint8_t msg[1000];
+    int failed = 0;
+
+    verify_hex(key, "85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b", 32);
+    poly1305(tag, (const uint8_t*) "Cryptographic Forum Research Group", 34, key);
+    failed += verify_bytes("poly1305 (RFC 8439 2.5.2)", tag, "a8061dc1305136c6c22b8baf0c0127a9", 16);
+
+    memset(key, 0, sizeof(key));
+    key[0] = 2;
+    memset(msg, 0xff, 16);
+    poly1305(tag, msg, 16, key);
+    failed += verify_bytes("poly1305 (RFC 8439 A.3 #5)", tag, "03000000000000000000000000000000", 16);
+
+    memset(key + 16, 0xff, 16);
+    memset(msg, 0, 16);
+    msg[0] = 2;
+    poly1305(tag, msg, 16, key);
+    failed += verify_bytes("poly1305 (RFC 8439 A.3 #6)", tag, "03000000000000000000000000000000", 16);
+
+    memset(key, 0, sizeof(key));
+    key[0] = 1;
+    verify_hex(msg, "ffffffffffffffffffffffffffffffff" "f0ffffffffffffffffffffffffffffff" "11000000000000000000000000000000", 48);
+    poly1305(tag, msg, 48, key);
+    failed += verify_bytes("poly1305 (RFC 8439 A.3 #7)", tag, "05000000000000000000000000000000", 16);
+
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key[i] = i * 7 + 1;
+    }
+    for (size_t i = 0; i < sizeof(msg); i++) {
+        msg[i] = i * 31 + 5;
+    }
+
+    for (size_t f = 0; f < 3; f++) {
+        if ((cpu_features() & features[f]) != features[f]) {
+            printf("Skipping poly1305 (%s), the CPU does not support it\n", names[f]);
+            continue;
+        }
+
+        struct poly1305_ctx ctx;
+        char name[64];
+
+        poly1305_init_features(&ctx, key, features[f]);
+        poly1305_update(&ctx, msg, sizeof(msg));
+        poly1305_final(&ctx, tag);
+        snprintf(name, sizeof(name), "poly1305 (%s, 1000 bytes)", names[f]);
+        failed += verify_bytes(name, tag, "89f5f3a6053282657ef4c10afec47507", 16);
+
+        poly1305_init_features(&ctx, key, features[f]);
+        for (size_t n = 0, step = 1; n < sizeof(msg); n += step, step = step * 3 + 1) {
+            poly1305_update(&ctx, msg + n, sizeof(msg) - n < step ? sizeof(msg) - n : step);
+        }
+        poly1305_final(&ctx, tag);
+        snprintf(name, sizeof(name), "poly1305 (%s, 1000 bytes in pieces)", names[f]);
+        failed += verify_bytes(name, tag, "89f5f3a6053282657ef4c10afec47507", 16);
+    }
+
+    return failed;
+}
+
+/*  Poly1305 and XSalsa20-Poly1305. The secretbox vector is the one of NaCl
+*   (tests/secretbox.c). A longer message over several tiles is compared with a
+*   separate XSalsa20 and Poly1305 pass, opened in place and rejected after a bit of
+*   the cipher text or the tag was flipped.
+*/
+int verify_secretbox(){
+    int failed = verify_poly1305();
+    uint32_t key[8];
+    uint8_t nonce[SECRETBOX_NONCE_SIZE];
+    uint8_t tag[SECRETBOX_TAG_SIZE];
+    uint8_t m[131];
+    uint8_t c[131];
+
+    verify_hex((uint8_t*) key, "1b27556473e985d462cd51197a9a46c76009549eac6474f206c4ee0844f68389", 32);
+    verify_hex(nonce, "69696ee955b62b73cd62bda875fc73d68219e0036b7a0b37", 24);
+    verify_hex(m, "be075fc53c81f2d5cf141316ebeb0c7b5228c52a4c62cbd44b66849b64244ffc"
+        "e5ecbaaf33bd751a1ac728d45e6c61296cdc3c01233561f41db66cce314adb31"
+        "0e3be8250c46f06dceea3a7fa1348057e2f6556ad6b1318a024a838f21af1fde"
+        "048977eb48f59ffd4924ca1c60902e52f0a089bc76897040e082f937763848645e0705", 131);
+
+    secretbox_seal(tag, c, m, sizeof(m), nonce, key);
+    failed += verify_bytes("secretbox_seal (NaCl secretbox, tag)", tag, "f3ffc7703f9400e52a7dfb4b3d3305d9", 16);
+    failed += verify_bytes("secretbox_seal (NaCl secretbox, cipher text)", c,
+        "8e993b9f48681273c29650ba32fc76ce48332ea7164d96a4476fb8c531a1186a"
+        "c0dfc17c98dce87b4da7f011ec48c97271d2c20f9b928fe2270d6fb863d51738"
+        "b48eeee314a7cc8ab932164548e526ae90224368517acfeabd6bb3732bc0e9da"
+        "99832b61ca01b6de56244a9e88d5f9b37973f622a43d14a6599b1f654cb45a74e355a5", 131);
+
+    size_t mlen = 100003;
+    uint8_t* msg = malloc(mlen);
+    uint8_t* cipher = malloc(mlen);
+    uint8_t* expected = malloc(mlen);
+    if (!msg || !cipher || !expected) {
+        fprintf(stderr, "Could not allocate enough memory for the verification of secretbox\n");
+        free(msg);
+        free(cipher);
+        free(expected);
+        return failed + 1;
+    }
+    for (size_t i = 0; i < mlen; i++) {
+        msg[i] = i * 31 + 5;
+    }
+
+    // Reference: the Poly1305 key is the first 32 bytes of key stream, the message follows
+    uint8_t mac_key[POLY1305_KEY_SIZE] = { 0 };
+    uint8_t expected_tag[SECRETBOX_TAG_SIZE];
+    xsalsa20_crypt(sizeof(mac_key), mac_key, mac_key, key, nonce, 0);
+    xsalsa20_crypt(mlen, msg, expected, key, nonce, 32);
+    poly1305(expected_tag, expected, mlen, mac_key);
+
+    secretbox_seal(tag, cipher, msg, mlen, nonce, key);
+    if (!memcmp(cipher, expected, mlen) && !memcmp(tag, expected_tag, sizeof(tag))) {
+        printf("secretbox_seal (%lu bytes) is\x1B[1;36m equivalent\x1B[0m to xsalsa20_crypt and poly1305\n", mlen);
+    } else {
+        printf("secretbox_seal (%lu bytes) is\x1B[1;31m not equivalent\x1B[0m to xsalsa20_crypt and poly1305!\n", mlen);
+        failed++;
+    }
+
+    memcpy(expected, cipher, mlen);
+    if (!secretbox_open(expected, expected, mlen, tag, nonce, key) && !memcmp(expected, msg, mlen)) {
+        printf("secretbox_open (%lu bytes, in place) is\x1B[1;36m equivalent\x1B[0m to the message\n", mlen);
+    } else {
+        printf("secretbox_open (%lu bytes, in place) is\x1B[1;31m not equivalent\x1B[0m to the message!\n", mlen);
+        failed++;
+    }
+
+    int forgery_failed = 0;
+    cipher[mlen / 2] ^= 4;
+    forgery_failed |= !secretbox_open(expected, cipher, mlen, tag, nonce, key);
+    cipher[mlen / 2] ^= 4;
+    tag[15] ^= 0x80;
+    forgery_failed |= !secretbox_open(expected, cipher, mlen, tag, nonce, key);
+    for (size_t i = 0; i < mlen; i++) {
+        forgery_failed |= expected[i];
+    }
+    if (!forgery_failed) {
+        printf("secretbox_open rejects a modified cipher text and tag and wipes the output\n");
+    } else {
+        printf("secretbox_open\x1B[1;31m accepts\x1B[0m a modified cipher text or tag!\n");
+        failed++;
+    }
+    printf("\n");
+
+    free(msg);
+    free(cipher);
+    free(expected);
     return failed;
 }
@@ -3,5 +3,11 @@
 
 int verify_core();
 int verify_crypt();
+int verify_stream();
+int verify_batch();
+int verify_rounds();
+int verify_scrypt();
+int verify_xsalsa20();
+int verify_secretbox();
 
 #endif
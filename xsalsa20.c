@@ -0,0 +1,139 @@
+#include <aio.h>
+#include <stdint.h>
+#include <string.h>
+#include <emmintrin.h>
+
+#include "core_v3.h"
+#include "dispatch.h"
+#include "stream.h"
+#include "xsalsa20.h"
+
+/*  XSalsa20 extends the nonce to 192 bits: HSalsa20 turns the key and the first 128
+*   bits of the nonce into a subkey, which is used as Salsa20 key together with the
+*   last 64 bits of the nonce as iv. Every other part of the library can then be used
+*   unchanged with the subkey.
+*/
+
+/*  One cached subkey. A hit needs the same key and the same nonce prefix, comparing
+*   the complete inputs instead of a hash of them makes collisions impossible.
+*/
+struct xsalsa20_entry {
+    uint32_t key[8];
+    uint8_t prefix[16];
+    uint32_t subkey[8];
+    int valid;
+};
+
+/*  Direct mapped cache per thread: no locking, and a connection that sends many
+*   messages under the same nonce prefix derives its subkey once.
+*/
+struct xsalsa20_cache {
+    struct xsalsa20_entry entries[XSALSA20_CACHE_SIZE];
+    uint64_t hits;
+    uint64_t misses;
+};
+
+static _Thread_local struct xsalsa20_cache cache;
+
+/*  HSalsa20: the 20 rounds of the Salsa20 core on the key, the constants and the nonce
+*   prefix (in place of iv and counter), without the final addition of the input. The
+*   subkey consists of the words 0, 5, 10, 15 and 6, 7, 8, 9 of the result.
+*
+*   The rounds are those of salsa20_core_v3 in its diagonal layout (row k, lane i holds
+*   word (4 * k + 5 * i) % 16). The first half of the subkey is row 0 there.
+*/
+void hsalsa20(uint32_t subkey[8], const uint32_t key[8], const uint8_t nonce[16]) {
+    uint32_t n[4];
+    uint32_t rows[4][4];
+    memcpy(n, nonce, sizeof(n));
+
+    __m128i r[4] = {
+        _mm_setr_epi32(0x61707865, 0x3320646e, 0x79622d32, 0x6b206574),
+        _mm_setr_epi32(key[3], n[3], key[7], key[2]),
+        _mm_setr_epi32(n[2], key[6], key[1], n[1]),
+        _mm_setr_epi32(key[5], key[0], n[0], key[4])
+    };
+
+    salsa20_core_v3_diag(r, 20);
+
+    for (size_t k = 0; k < 4; k++) {
+        _mm_storeu_si128((__m128i_u*) rows[k], r[k]);
+    }
+    memcpy(subkey, rows[0], 16);
+    subkey[4] = rows[3][2];     // word 6
+    subkey[5] = rows[2][3];     // word 7
+    subkey[6] = rows[2][0];     // word 8
+    subkey[7] = rows[1][1];     // word 9
+
+    explicit_bzero(rows, sizeof(rows));
+}
+
+// Slot of a key and nonce prefix in the cache
+static size_t xsalsa20_slot(const uint32_t key[8], const uint32_t prefix[4]) {
+    uint32_t h = key[0] ^ key[7];
+    for (size_t i = 0; i < 4; i++) {
+        h = (h ^ prefix[i]) * 0x9e3779b1;
+    }
+    return (h >> 16) % XSALSA20_CACHE_SIZE;
+}
+
+/*  Subkey of the key and the 128 bit nonce prefix, from the cache of the calling
+*   thread if it was derived before. Otherwise it is derived with hsalsa20 and replaces
+*   the entry in its slot.
+*/
+void xsalsa20_subkey(uint32_t subkey[8], const uint32_t key[8], const uint8_t nonce[16]) {
+    uint32_t prefix[4];
+    memcpy(prefix, nonce, sizeof(prefix));
+
+    struct xsalsa20_entry* e = &cache.entries[xsalsa20_slot(key, prefix)];
+
+    if (e->valid && !memcmp(e->prefix, nonce, 16) && !memcmp(e->key, key, sizeof(e->key))) {
+        cache.hits++;
+    } else {
+        cache.misses++;
+        hsalsa20(e->subkey, key, nonce);
+        memcpy(e->key, key, sizeof(e->key));
+        memcpy(e->prefix, nonce, 16);
+        e->valid = 1;
+    }
+    memcpy(subkey, e->subkey, sizeof(e->subkey));
+}
+
+/*  En-/decrypts mlen bytes with XSalsa20 starting at byte offset of the key stream,
+*   with the fastest implementation supported by the CPU. Like the crypt functions it
+*   works in place.
+*/
+void xsalsa20_crypt(size_t mlen, const uint8_t msg[], uint8_t cipher[], const uint32_t key[8], const uint8_t nonce[24], uint64_t offset) {
+    const struct salsa20_impl* impl = salsa20_dispatch();
+    uint32_t subkey[8];
+    uint64_t iv;
+
+    xsalsa20_subkey(subkey, key, nonce);
+    memcpy(&iv, nonce + 16, sizeof(iv));
+    impl->crypt(mlen, msg, cipher, subkey, iv, offset, impl->core);
+
+    explicit_bzero(subkey, sizeof(subkey));
+}
+
+// Initializes a context of the incremental interface (see salsa20_init) for XSalsa20
+void xsalsa20_init(struct salsa20_ctx* ctx, const uint32_t key[8], const uint8_t nonce[24]) {
+    uint32_t subkey[8];
+    uint64_t iv;
+
+    xsalsa20_subkey(subkey, key, nonce);
+    memcpy(&iv, nonce + 16, sizeof(iv));
+    salsa20_init(ctx, subkey, iv);
+
+    explicit_bzero(subkey, sizeof(subkey));
+}
+
+// Number of lookups of the calling thread that found their subkey in the cache and that did not
+void xsalsa20_cache_stats(uint64_t* hits, uint64_t* misses) {
+    *hits = cache.hits;
+    *misses = cache.misses;
+}
+
+// Wipes the cached keys and subkeys of the calling thread
+void xsalsa20_cache_wipe(void) {
+    explicit_bzero(&cache, sizeof(cache));
+}
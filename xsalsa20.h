@@ -0,0 +1,24 @@
+#ifndef SALSA20_XSALSA20_H
+#define SALSA20_XSALSA20_H
+
+#include <aio.h>
+#include <stdint.h>
+
+#include "stream.h"
+
+// Number of (key, nonce prefix) pairs whose HSalsa20 subkey is cached per thread
+#define XSALSA20_CACHE_SIZE 16
+
+void hsalsa20(uint32_t subkey[8], const uint32_t key[8], const uint8_t nonce[16]);
+
+void xsalsa20_subkey(uint32_t subkey[8], const uint32_t key[8], const uint8_t nonce[16]);
+
+void xsalsa20_crypt(size_t mlen, const uint8_t msg[], uint8_t cipher[], const uint32_t key[8], const uint8_t nonce[24], uint64_t offset);
+
+void xsalsa20_init(struct salsa20_ctx* ctx, const uint32_t key[8], const uint8_t nonce[24]);
+
+void xsalsa20_cache_stats(uint64_t* hits, uint64_t* misses);
+
+void xsalsa20_cache_wipe(void);
+
+#endif  // SALSA20_XSALSA20_H